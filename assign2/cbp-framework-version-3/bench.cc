@@ -0,0 +1,193 @@
+/* Description: This file defines the per-branch latency benchmark; see bench.h.
+*/
+
+#include "bench.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+double bench_timer_c::ticks_per_ns(){
+    static double calibrated = 0;
+    if(calibrated == 0){
+        // spin for 50 ms of the system clock and count the ticks
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        uint64_t start_ticks = now();
+        chrono::steady_clock::time_point end;
+        do{
+            end = chrono::steady_clock::now();
+        } while(end - start < chrono::milliseconds(50));
+        uint64_t ticks = now() - start_ticks;
+        calibrated = ticks / double(chrono::duration_cast<chrono::nanoseconds>(end - start).count());
+    }
+    return calibrated;
+}
+
+latency_histogram_c::latency_histogram_c(){
+    memset(buckets, 0, sizeof(buckets));
+    count = 0;
+    sum   = 0;
+    min   = ~uint64_t(0);
+    max   = 0;
+}
+int latency_histogram_c::bucket(uint64_t ticks){
+    if(ticks < SUB_BUCKETS){
+        return int(ticks);
+    }
+    int e = 63 - __builtin_clzll(ticks);
+    return (e - 3) * SUB_BUCKETS + int((ticks >> (e - 4)) & (SUB_BUCKETS - 1));
+}
+uint64_t latency_histogram_c::bucket_low(int b){
+    if(b < SUB_BUCKETS){
+        return b;
+    }
+    int e = b / SUB_BUCKETS + 3;
+    return uint64_t(SUB_BUCKETS + b % SUB_BUCKETS) << (e - 4);
+}
+uint64_t latency_histogram_c::percentile(double q) const{
+    uint64_t target = uint64_t(q * count);
+    uint64_t seen = 0;
+    for(int b = 0; b < NUM_BUCKETS; b++){
+        seen += buckets[b];
+        if(seen > target){
+            if(b < SUB_BUCKETS || b == NUM_BUCKETS - 1){
+                return bucket_low(b);
+            }
+            return (bucket_low(b) + bucket_low(b + 1)) / 2;
+        }
+    }
+    return max;
+}
+
+bench_counters_c::bench_counters_c(){
+    for(int i = 0; i < NUM_COUNTERS; i++){
+        fds[i] = -1;
+    }
+}
+bench_counters_c::~bench_counters_c(){
+#ifdef __linux__
+    for(int i = 0; i < NUM_COUNTERS; i++){
+        if(fds[i] >= 0){
+            close(fds[i]);
+        }
+    }
+#endif
+}
+bool bench_counters_c::open(string *error){
+#ifdef __linux__
+    static const uint64_t configs[NUM_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    for(int i = 0; i < NUM_COUNTERS; i++){
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size           = sizeof(attr);
+        attr.type           = PERF_TYPE_HARDWARE;
+        attr.config         = configs[i];
+        attr.disabled       = (i == 0);     // the group starts and stops with its leader
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        fds[i] = int(syscall(__NR_perf_event_open, &attr, 0, -1, (i == 0) ? -1 : fds[0], 0));
+        if(i == 0 && fds[0] < 0){
+            *error = string("perf_event_open: ") + strerror(errno);
+            return false;
+        }
+    }
+    return true;
+#else
+    *error = "perf_event_open is only on Linux";
+    return false;
+#endif
+}
+void bench_counters_c::enable(){
+#ifdef __linux__
+    ioctl(fds[0], PERF_EVENT_IOC_ENABLE, 0);
+#endif
+}
+void bench_counters_c::disable(){
+#ifdef __linux__
+    ioctl(fds[0], PERF_EVENT_IOC_DISABLE, 0);
+#endif
+}
+bool bench_counters_c::read(uint64_t values[NUM_COUNTERS], bool available[NUM_COUNTERS]) const{
+    bool any = false;
+    for(int i = 0; i < NUM_COUNTERS; i++){
+        values[i]    = 0;
+        available[i] = false;
+#ifdef __linux__
+        if(fds[i] >= 0 && ::read(fds[i], &values[i], sizeof(values[i])) == sizeof(values[i])){
+            available[i] = true;
+            any = true;
+        }
+#endif
+    }
+    return any;
+}
+
+predictor_bench_c::predictor_bench_c(bool use_counters_arg){
+    use_counters = use_counters_arg;
+    phase_start  = 0;
+    branch_ticks = 0;
+    for(int p = 0; p < BENCH_NUM_PHASES && use_counters; p++){
+        if(!counters[p].open(&counters_error)){
+            use_counters = false;
+        }
+    }
+    bench_timer_c::ticks_per_ns();      // calibrate before the clock starts
+}
+
+void predictor_bench_c::print() const{
+    static const char *const names[BENCH_NUM_PHASES] = { "decode", "predict", "update" };
+    double ticks_per_ns = bench_timer_c::ticks_per_ns();
+    // the timer's own cost, which every interval includes
+    uint64_t overhead = ~uint64_t(0);
+    for(int i = 0; i < 1000; i++){
+        uint64_t start = bench_timer_c::now();
+        uint64_t ticks = bench_timer_c::now() - start;
+        if(ticks < overhead) overhead = ticks;
+    }
+
+    printf("ns per branch          count       mean        min        p50        p90        p99        max\n");
+    for(int p = 0; p <= BENCH_NUM_PHASES; p++){
+        const latency_histogram_c &h = (p < BENCH_NUM_PHASES) ? phases[p] : totals;
+        if(h.count == 0){
+            continue;
+        }
+        printf("%-12s %12llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", (p < BENCH_NUM_PHASES) ? names[p] : "total",
+               (unsigned long long)h.count, h.sum / double(h.count) / ticks_per_ns, h.min / ticks_per_ns,
+               h.percentile(0.5) / ticks_per_ns, h.percentile(0.9) / ticks_per_ns,
+               h.percentile(0.99) / ticks_per_ns, h.max / ticks_per_ns);
+    }
+    printf("timer: %.3f ticks/ns, %.1f ns per reading included in each interval\n", ticks_per_ns, overhead / ticks_per_ns);
+
+    if(!counters_error.empty()){
+        printf("hardware counters unavailable: %s\n", counters_error.c_str());
+    }
+    else if(use_counters){
+        printf("per branch                cycles   instructions   cache misses  branch misses\n");
+        for(int p = 0; p < BENCH_NUM_PHASES; p++){
+            uint64_t values[bench_counters_c::NUM_COUNTERS];
+            bool available[bench_counters_c::NUM_COUNTERS];
+            counters[p].read(values, available);
+            printf("%-12s", names[p]);
+            for(int i = 0; i < bench_counters_c::NUM_COUNTERS; i++){
+                if(available[i] && phases[p].count){
+                    printf(" %14.2f", values[i] / double(phases[p].count));
+                }
+                else{
+                    printf(" %14s", "n/a");
+                }
+            }
+            printf("\n");
+        }
+    }
+    printf("*********************************************************\n");
+}
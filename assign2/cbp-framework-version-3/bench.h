@@ -0,0 +1,158 @@
+/* Description: This file defines the per-branch latency benchmark.  It times
+ * the three phases of each branch (the trace reader decoding it, get_prediction
+ * and update_predictor) with the time stamp counter, and prints the distribution
+ * of each in ns per branch.  Where perf_event_open allows, it also counts cycles,
+ * instructions, cache misses and branch misses in each phase.
+*/
+
+#ifndef BENCH_H_SEEN
+#define BENCH_H_SEEN
+
+#include <inttypes.h>
+#include <string>
+#include "tread.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+// the time stamp counter; elsewhere, a nanosecond clock
+class bench_timer_c
+{
+public:
+    static uint64_t now(){
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_lfence();                   // don't start before the instructions ahead of us finish
+        uint64_t ticks = __rdtsc();
+        _mm_lfence();
+        return ticks;
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+    // ticks per nanosecond, measured against the system clock the first time it's called
+    static double ticks_per_ns();
+};
+
+// A histogram of intervals in ticks.  Values below 16 have a bucket each; above that, each power
+// of two is split into 16 buckets, so a percentile is within 1/16 of the true value.
+class latency_histogram_c
+{
+private:
+    enum { SUB_BUCKETS = 16, NUM_BUCKETS = (64 - 3) * SUB_BUCKETS };
+    uint64_t buckets[NUM_BUCKETS];
+    static int bucket(uint64_t ticks);
+    static uint64_t bucket_low(int b);
+public:
+    latency_histogram_c();
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    void record(uint64_t ticks){
+        buckets[bucket(ticks)]++;
+        count++;
+        sum += ticks;
+        if(ticks < min) min = ticks;
+        if(ticks > max) max = ticks;
+    }
+    // the value below which the fraction q of the intervals fall, as the middle of its bucket
+    uint64_t percentile(double q) const;
+};
+
+// the phases of a branch the benchmark times separately
+enum bench_phase_t { BENCH_DECODE, BENCH_PREDICT, BENCH_UPDATE, BENCH_NUM_PHASES };
+
+// Hardware counters for one phase: a perf_event_open group that's enabled just around the phase.
+// The ioctls that do that disturb the caches and the pipeline the timings see, so the counters
+// are only read when asked for.
+class bench_counters_c
+{
+public:
+    enum { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, NUM_COUNTERS };
+private:
+    // not implemented
+    bench_counters_c(const bench_counters_c&);
+    bench_counters_c& operator=(const bench_counters_c&);
+    int fds[NUM_COUNTERS];          // -1 for a counter that couldn't be opened; fds[0] leads the group
+public:
+    bench_counters_c();
+    ~bench_counters_c();
+    // opens the counters; returns false, with the reason in 'error', if none could be
+    bool open(std::string *error);
+    void enable();
+    void disable();
+    // the counts so far; false for a counter that isn't available
+    bool read(uint64_t values[NUM_COUNTERS], bool available[NUM_COUNTERS]) const;
+};
+
+class predictor_bench_c
+{
+private:
+    // not implemented
+    predictor_bench_c(const predictor_bench_c&);
+    predictor_bench_c& operator=(const predictor_bench_c&);
+
+    latency_histogram_c phases[BENCH_NUM_PHASES];
+    latency_histogram_c totals;             // the three phases of each branch together
+    bench_counters_c counters[BENCH_NUM_PHASES];
+    bool use_counters;
+    std::string counters_error;
+    uint64_t phase_start;
+    uint64_t branch_ticks;
+public:
+    // use_counters asks for hardware counters; the benchmark runs without them if they can't be opened
+    predictor_bench_c(bool use_counters);
+
+    void start(bench_phase_t phase){
+        if(use_counters) counters[phase].enable();
+        phase_start = bench_timer_c::now();
+    }
+    // ends the phase; 'record' false drops the interval (the decode that finds the end of the trace)
+    void stop(bench_phase_t phase, bool record = true){
+        uint64_t ticks = bench_timer_c::now() - phase_start;
+        if(use_counters) counters[phase].disable();
+        if(!record){
+            return;
+        }
+        phases[phase].record(ticks);
+        branch_ticks += ticks;
+        if(phase == BENCH_UPDATE){
+            totals.record(branch_ticks);
+            branch_ticks = 0;
+        }
+    }
+    void print() const;
+};
+
+// Replays the trace through 'predictor', timing each phase of each branch, and prints the
+// distributions after the trace reader's statistics.
+template <class P>
+void bench_trace(P *predictor, char *trace_name, const cbp_reader_config_c &config, bool use_counters)
+{
+    predictor_bench_c bench(use_counters);
+    {
+        cbp_trace_reader_c cbptr(trace_name, config);
+        branch_record_c br;
+        while(true){
+            bench.start(BENCH_DECODE);
+            bool have_branch = cbptr.get_branch_record(&br);
+            bench.stop(BENCH_DECODE, have_branch);
+            if(!have_branch){
+                break;
+            }
+            bench.start(BENCH_PREDICT);
+            bool predicted_taken = predictor->get_prediction(&br, cbptr.osptr);
+            bench.stop(BENCH_PREDICT);
+            bool actual_taken    = cbptr.predict_branch(predicted_taken);
+            bench.start(BENCH_UPDATE);
+            predictor->update_predictor(&br, cbptr.osptr, actual_taken);
+            bench.stop(BENCH_UPDATE);
+        }
+    }
+    bench.print();
+}
+
+#endif // BENCH_H_SEEN
@@ -0,0 +1,114 @@
+/* Description: This file defines branch_profile_c, the per-interval and
+ * per-branch mispredict profile of a trace; see branch_profile.h.
+*/
+
+#include "branch_profile.h"
+#include <algorithm>
+
+using namespace std;
+
+branch_profile_c::branch_profile_c(uint64_t interval_arg, uint32_t top_arg, uint64_t sample_period_arg,
+                                   uint64_t sample_warmup_arg, uint64_t sample_length_arg){
+    interval      = interval_arg;
+    top           = top_arg;
+    sample_period = sample_period_arg;
+    sample_warmup = sample_warmup_arg;
+    sample_length = sample_length_arg;
+    table_used    = 0;
+    if(top){
+        table.resize(1 << 12);
+    }
+}
+
+branch_profile_entry_c *branch_profile_c::find(uint32_t pc){
+    size_t mask = table.size() - 1;
+    for(size_t i = slot(pc, mask); ; i = (i + 1) & mask){
+        branch_profile_entry_c *e = &table[i];
+        if(e->executions && e->pc == pc){
+            return e;
+        }
+        if(!e->executions){
+            if(2 * (table_used + 1) > table.size()){
+                grow();
+                return find(pc);
+            }
+            table_used++;
+            e->pc = pc;
+            return e;
+        }
+    }
+}
+
+void branch_profile_c::grow(){
+    vector<branch_profile_entry_c> old(table.size() * 2);
+    old.swap(table);
+    size_t mask = table.size() - 1;
+    for(size_t j = 0; j < old.size(); j++){
+        if(old[j].executions){
+            size_t i = slot(old[j].pc, mask);
+            while(table[i].executions){
+                i = (i + 1) & mask;
+            }
+            table[i] = old[j];
+        }
+    }
+}
+
+// in sampling mode, the instructions at offsets sample_warmup up to sample_warmup + sample_length
+// of each sample period are scored
+uint64_t branch_profile_c::scored_insts(uint64_t n) const{
+    if(!sample_period){
+        return n;
+    }
+    uint64_t offset = n % sample_period;
+    uint64_t partial = offset > sample_warmup ? min(offset - sample_warmup, sample_length) : 0;
+    return n / sample_period * sample_length + partial;
+}
+
+// the hardest branches first: most mispredicts, then most executions, then lowest PC
+static bool harder(const branch_profile_entry_c &a, const branch_profile_entry_c &b){
+    if(a.mispredicts != b.mispredicts){
+        return a.mispredicts > b.mispredicts;
+    }
+    if(a.executions != b.executions){
+        return a.executions > b.executions;
+    }
+    return a.pc < b.pc;
+}
+
+void branch_profile_c::print(FILE *out, uint64_t num_insts) const{
+    uint64_t total_mispredicts = 0;
+    if(interval){
+        fprintf(out, "mispredicts per %llu instructions\n", (unsigned long long)interval);
+        fprintf(out, "     first inst scored insts  cc branches  mispredicts     mpki\n");
+        for(size_t k = 0; k < intervals.size(); k++){
+            uint64_t start = k * interval;
+            uint64_t end   = min(start + interval, max(num_insts, start + 1));
+            uint64_t insts = scored_insts(end) - scored_insts(start);
+            fprintf(out, "%15llu %12llu %12u %12u %8.3f\n", (unsigned long long)start, (unsigned long long)insts,
+                    intervals[k].cc_branches, intervals[k].mispredicts,
+                    insts ? 1000.0 * intervals[k].mispredicts / insts : 0.0);
+        }
+        fprintf(out, "*********************************************************\n");
+    }
+    if(top){
+        vector<branch_profile_entry_c> branches;
+        for(size_t i = 0; i < table.size(); i++){
+            if(table[i].executions){
+                branches.push_back(table[i]);
+                total_mispredicts += table[i].mispredicts;
+            }
+        }
+        size_t n = min(size_t(top), branches.size());
+        partial_sort(branches.begin(), branches.begin() + n, branches.end(), harder);
+        fprintf(out, "hardest %u of %u static conditional branches\n", uint(n), uint(branches.size()));
+        fprintf(out, "        pc   executions  mispredicts  mispredict %%  share of mispredicts %%\n");
+        for(size_t i = 0; i < n; i++){
+            const branch_profile_entry_c &e = branches[i];
+            fprintf(out, "%10x %12u %12u %13.2f %23.2f\n", e.pc, e.executions, e.mispredicts,
+                    100.0 * e.mispredicts / e.executions,
+                    total_mispredicts ? 100.0 * e.mispredicts / total_mispredicts : 0.0);
+        }
+        fprintf(out, "*********************************************************\n");
+    }
+}
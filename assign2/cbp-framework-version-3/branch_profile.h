@@ -0,0 +1,82 @@
+/* Description: This file defines branch_profile_c, which the trace reader fills
+ * in with the outcome of every scored conditional branch when profiling is
+ * asked for: the mispredicts in each fixed interval of instructions, as a time
+ * series, and the executions and mispredicts of each static branch, from which
+ * the hardest branches of the trace are listed.
+*/
+
+#ifndef BRANCH_PROFILE_H_SEEN
+#define BRANCH_PROFILE_H_SEEN
+
+#include <cstdio>
+#include <inttypes.h>
+#include <vector>
+
+// the counts of one static conditional branch
+class branch_profile_entry_c
+{
+public:
+    uint32_t pc;
+    uint32_t executions;           // 0 for an empty slot of the table
+    uint32_t mispredicts;
+};
+
+// the scored conditional branches of one interval of the time series
+class branch_profile_interval_c
+{
+public:
+    branch_profile_interval_c() : cc_branches(0), mispredicts(0) {}
+    uint32_t cc_branches;
+    uint32_t mispredicts;
+};
+
+class branch_profile_c
+{
+private:
+    // not implemented
+    branch_profile_c(const branch_profile_c&);
+    branch_profile_c& operator=(const branch_profile_c&);
+
+    uint64_t interval;                                  // instructions per interval; 0 for no time series
+    // the trace reader's sampling (see cbp_reader_config_c in tread.h); sample_period is 0 when
+    // every instruction is scored
+    uint64_t sample_period, sample_warmup, sample_length;
+    uint32_t top;                                       // static branches to list; 0 for no per-branch table
+    std::vector<branch_profile_interval_c> intervals;
+    // open addressing with linear probing, kept at most half full so a lookup rarely goes
+    // past the slot the PC hashes to; the size is a power of two
+    std::vector<branch_profile_entry_c> table;
+    size_t table_used;
+
+    static size_t slot(uint32_t pc, size_t mask) { return (size_t(pc) * 0x9e3779b1u >> 7) & mask; }
+    branch_profile_entry_c *find(uint32_t pc);
+    void grow();
+    // the scored instructions among the first n
+    uint64_t scored_insts(uint64_t n) const;
+public:
+    branch_profile_c(uint64_t interval, uint32_t top, uint64_t sample_period, uint64_t sample_warmup,
+                     uint64_t sample_length);
+
+    // records a scored conditional branch; num_insts is the number of instructions up to and
+    // including it, counted the way the trace reader counts them
+    void record(uint32_t pc, uint64_t num_insts, bool mispredicted){
+        if(interval){
+            uint64_t k = (num_insts - 1) / interval;
+            if(k >= intervals.size()){
+                intervals.resize(k + 1);
+            }
+            intervals[k].cc_branches++;
+            intervals[k].mispredicts += mispredicted;
+        }
+        if(top){
+            branch_profile_entry_c *e = find(pc);
+            e->executions++;
+            e->mispredicts += mispredicted;
+        }
+    }
+    // prints the time series, with the last interval cut short at num_insts, and the hardest
+    // static branches; each interval's MPKI is over its scored instructions
+    void print(FILE *out, uint64_t num_insts) const;
+};
+
+#endif // BRANCH_PROFILE_H_SEEN
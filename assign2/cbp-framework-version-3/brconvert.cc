@@ -0,0 +1,71 @@
+/* Description: Converts a CBP trace into a branch record trace (.brt) that the
+ * driver can replay without decompressing or decoding the original trace.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "brtrace.h"
+#include "bz2_input.h"
+#include "cbp_inst.h"
+
+static void
+usage(const char* prog)
+{
+    printf("usage: %s [--decode-threads=N] <trace> [<output>]\n", prog);
+    printf("  reads <trace>.bz2 and writes the branch trace <output> (default: <trace>.brt)\n");
+    exit(EXIT_FAILURE);
+}
+
+// usage: brconvert [--decode-threads=N] <trace> [<output>]
+int
+main(int argc, char* argv[])
+{
+    using namespace std;
+    using namespace cbp;
+
+    unsigned decode_threads = 0;
+    const char* trace_name = 0;
+    const char* output_name = 0;
+    for (int i = 1; i < argc; i++) {
+        if (0 == strncmp(argv[i], "--decode-threads=", 17)) {
+            decode_threads = atoi(argv[i] + 17);
+        } else if (('-' != argv[i][0]) && !trace_name) {
+            trace_name = argv[i];
+        } else if (('-' != argv[i][0]) && !output_name) {
+            output_name = argv[i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (!trace_name) {
+        usage(argv[0]);
+    }
+
+    string trace_file_name = string(trace_name) + ".bz2";
+    string output_file_name = output_name ? string(output_name) : (string(trace_name) + ".brt");
+
+    CBP_INPUT* input = bz2_input_open(trace_file_name.c_str(), decode_threads);
+    CBP_INST_STREAM* stream = cbp_inst_open(input);
+    br_trace_writer_c writer(output_file_name.c_str());
+
+    // count instructions exactly the way cbp_trace_reader_c does, so a replay
+    // reports the same statistics as decoding the original trace
+    CBP_INST inst;
+    uint num_insts = 0;
+    while (cbp_inst_read(stream, &inst)) {
+        num_insts++;
+        if (inst.is_branch) {
+            writer.add_branch(inst.instruction_addr, inst.branch_target, inst.instruction_next_addr,
+                              inst.is_indirect, inst.is_conditional, inst.is_call, inst.is_return,
+                              inst.taken, num_insts);
+            num_insts = 0;
+        }
+    }
+    writer.finish(num_insts);
+
+    cbp_inst_close(stream);
+    delete input;
+    return 0;
+}
@@ -0,0 +1,108 @@
+/* Description: This file defines the branch record trace (.brt) format: a
+ * pre-decoded trace that holds only the branches of a CBP trace, so repeated
+ * predictor runs can skip bzip2 decompression and CBP_INST decoding.  A .brt
+ * file is written once with brconvert and replayed by the trace reader with
+ * mmap.
+*/
+
+#include "brtrace.h"
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+const char BR_TRACE_MAGIC[8] = { 'C', 'B', 'P', 'B', 'R', 'T', '\n', '\0' };
+
+br_trace_file_c::br_trace_file_c(const char *path){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){
+        fprintf(stderr, "cannot open branch trace %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(br_trace_header_c)){
+        fprintf(stderr, "%s is not a branch trace\n", path);
+        exit(EXIT_FAILURE);
+    }
+    map_size = st.st_size;
+    map_base = mmap(0, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map_base == MAP_FAILED){
+        fprintf(stderr, "cannot map branch trace %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    // the records are read once, front to back
+    madvise(map_base, map_size, MADV_SEQUENTIAL);
+
+    header  = (const br_trace_header_c *)map_base;
+    records = (const br_trace_record_c *)(header + 1);
+    next_record = 0;
+    if(memcmp(header->magic, BR_TRACE_MAGIC, sizeof(BR_TRACE_MAGIC)) != 0
+       || header->version != BR_TRACE_VERSION
+       || header->record_size != sizeof(br_trace_record_c)){
+        fprintf(stderr, "%s is not a version %u branch trace; rerun brconvert\n", path, BR_TRACE_VERSION);
+        exit(EXIT_FAILURE);
+    }
+    if(sizeof(br_trace_header_c) + header->num_records * sizeof(br_trace_record_c) > map_size){
+        fprintf(stderr, "branch trace %s is truncated\n", path);
+        exit(EXIT_FAILURE);
+    }
+}
+br_trace_file_c::~br_trace_file_c(){
+    munmap(map_base, map_size);
+}
+
+br_trace_writer_c::br_trace_writer_c(const char *path_arg) : path(path_arg){
+    file = fopen(path.c_str(), "wb");
+    if(!file){
+        fprintf(stderr, "cannot create branch trace %s\n", path.c_str());
+        exit(EXIT_FAILURE);
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BR_TRACE_MAGIC, sizeof(BR_TRACE_MAGIC));
+    header.version     = BR_TRACE_VERSION;
+    header.record_size = sizeof(br_trace_record_c);
+    // the header is rewritten by finish() once the counts are known
+    fwrite(&header, sizeof(header), 1, file);
+}
+br_trace_writer_c::~br_trace_writer_c(){
+    if(file){
+        fclose(file);
+    }
+}
+void br_trace_writer_c::add_branch(uint32_t instruction_addr, uint32_t branch_target, uint32_t instruction_next_addr,
+                                   bool is_indirect, bool is_conditional, bool is_call, bool is_return,
+                                   bool taken, uint num_insts){
+    if(num_insts > br_trace_record_c::BR_TRACE_MAX_INSTS){
+        fprintf(stderr, "%u instructions between branches is too many for a branch trace\n", num_insts);
+        exit(EXIT_FAILURE);
+    }
+    br_trace_record_c rec;
+    rec.instruction_addr      = instruction_addr;
+    rec.branch_target         = branch_target;
+    rec.instruction_next_addr = instruction_next_addr;
+    rec.info                  = (num_insts << br_trace_record_c::BR_TRACE_INSTS_SHIFT)
+                              | (is_indirect    ? br_trace_record_c::BR_TRACE_IS_INDIRECT    : 0)
+                              | (is_conditional ? br_trace_record_c::BR_TRACE_IS_CONDITIONAL : 0)
+                              | (is_call        ? br_trace_record_c::BR_TRACE_IS_CALL        : 0)
+                              | (is_return      ? br_trace_record_c::BR_TRACE_IS_RETURN      : 0)
+                              | (taken          ? br_trace_record_c::BR_TRACE_TAKEN          : 0);
+    fwrite(&rec, sizeof(rec), 1, file);
+    header.num_records++;
+    header.num_insts += num_insts;
+}
+void br_trace_writer_c::finish(uint64_t tail_insts){
+    header.tail_insts = tail_insts;
+    header.num_insts += tail_insts;
+    if(fseek(file, 0, SEEK_SET) != 0
+       || fwrite(&header, sizeof(header), 1, file) != 1
+       || fclose(file) != 0){
+        fprintf(stderr, "error writing branch trace %s\n", path.c_str());
+        exit(EXIT_FAILURE);
+    }
+    file = 0;
+}
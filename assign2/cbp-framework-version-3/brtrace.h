@@ -0,0 +1,107 @@
+/* Description: This file defines the branch record trace (.brt) format: a
+ * pre-decoded trace that holds only the branches of a CBP trace, so repeated
+ * predictor runs can skip bzip2 decompression and CBP_INST decoding.  A .brt
+ * file is written once with brconvert and replayed by the trace reader with
+ * mmap.
+*/
+
+#ifndef BRTRACE_H_SEEN
+#define BRTRACE_H_SEEN
+
+#include <cstddef>
+#include <cstdio>
+#include <inttypes.h>
+#include <string>
+
+typedef unsigned int uint;
+
+// A .brt file is a br_trace_header_c followed by num_records br_trace_record_c's,
+// all in the byte order of the machine that wrote it.
+class br_trace_header_c
+{
+public:
+    char     magic[8];             // BR_TRACE_MAGIC
+    uint32_t version;              // BR_TRACE_VERSION
+    uint32_t record_size;          // sizeof(br_trace_record_c)
+    uint64_t num_records;          // number of branches in the trace
+    uint64_t num_insts;            // number of instructions in the trace
+    uint64_t tail_insts;           // instructions after the last branch
+};
+
+class br_trace_record_c
+{
+public:
+    uint32_t instruction_addr;     // the branch's PC
+    uint32_t branch_target;        // the target of the branch if it's taken
+    uint32_t instruction_next_addr;// the PC of the static instruction following the branch
+    uint32_t info;                 // BR_TRACE_* flag bits, and the instruction count in the upper bits
+
+    // number of instructions since the previous branch, counting this branch
+    uint num_insts() const { return info >> BR_TRACE_INSTS_SHIFT; }
+
+    static const uint32_t BR_TRACE_IS_INDIRECT    = 0x01;
+    static const uint32_t BR_TRACE_IS_CONDITIONAL = 0x02;
+    static const uint32_t BR_TRACE_IS_CALL        = 0x04;
+    static const uint32_t BR_TRACE_IS_RETURN      = 0x08;
+    static const uint32_t BR_TRACE_TAKEN          = 0x10;
+    static const int      BR_TRACE_INSTS_SHIFT    = 5;
+    static const uint32_t BR_TRACE_MAX_INSTS      = (uint32_t(1) << (32 - BR_TRACE_INSTS_SHIFT)) - 1;
+};
+
+extern const char     BR_TRACE_MAGIC[8];
+const uint32_t        BR_TRACE_VERSION = 1;
+
+// br_trace_file_c maps a .brt file into memory for replay.
+class br_trace_file_c
+{
+private:
+    // not implemented
+    br_trace_file_c(const br_trace_file_c&);
+    br_trace_file_c& operator=(const br_trace_file_c&);
+
+    void *map_base;
+    std::size_t map_size;
+    const br_trace_header_c *header;
+    const br_trace_record_c *records;
+    uint64_t next_record;
+public:
+    // maps 'path'; exits with an error message if it isn't a valid .brt file
+    explicit br_trace_file_c(const char *path);
+    ~br_trace_file_c();
+    uint64_t num_records() const { return header->num_records; }
+    uint64_t num_insts() const { return header->num_insts; }
+    uint64_t tail_insts() const { return header->tail_insts; }
+    // returns the next record, or 0 at the end of the trace
+    const br_trace_record_c *next(){
+        if(next_record == header->num_records){
+            return 0;
+        }
+        return records + next_record++;
+    }
+};
+
+// br_trace_writer_c writes a .brt file one branch at a time.
+class br_trace_writer_c
+{
+private:
+    // not implemented
+    br_trace_writer_c(const br_trace_writer_c&);
+    br_trace_writer_c& operator=(const br_trace_writer_c&);
+
+    std::string path;
+    std::FILE *file;
+    br_trace_header_c header;
+public:
+    // creates 'path'; exits with an error message if it can't
+    explicit br_trace_writer_c(const char *path_arg);
+    ~br_trace_writer_c();
+    // appends a branch; 'num_insts' counts the instructions since the previous
+    // branch, including this one
+    void add_branch(uint32_t instruction_addr, uint32_t branch_target, uint32_t instruction_next_addr,
+                    bool is_indirect, bool is_conditional, bool is_call, bool is_return,
+                    bool taken, uint num_insts);
+    // writes the header; 'tail_insts' counts the instructions after the last branch
+    void finish(uint64_t tail_insts);
+};
+
+#endif // BRTRACE_H_SEEN
@@ -0,0 +1,413 @@
+/* Description: This file defines BZ2_INPUT, a CBP_INPUT that decompresses a
+ * bzip2-compressed trace in-process with libbz2, so the trace reader no longer
+ * needs an external bzip2 process and a pipe.  It also defines
+ * BZ2_PARALLEL_INPUT, which decompresses the blocks of a trace on a pool of
+ * threads.
+*/
+
+#include "bz2_input.h"
+#include <cstring>
+#include "cbp_assert.h"
+#include "cbp_fatal.h"
+
+namespace cbp
+{
+    using namespace std;
+
+    BZ2_INPUT::BZ2_INPUT(const char* path_arg, uint64_t offset)
+        : path(path_arg),
+          file(0),
+          strm_valid(false),
+          at_eof(false),
+          in_buffer(new uint8_t[IN_BUFFER_SIZE]),
+          out_buffer(new uint8_t[OUT_BUFFER_SIZE])
+    {
+        out_head = out_buffer;
+        out_tail = out_buffer;
+
+        file = fopen(path.c_str(), "rb");
+        if (!file)
+            CBP_FATAL("cannot open trace file %s", path.c_str());
+        if ((offset != 0) && (fseeko(file, static_cast<off_t>(offset), SEEK_SET) != 0))
+            CBP_FATAL("cannot seek to byte %llu of %s", static_cast<unsigned long long>(offset), path.c_str());
+
+        memset(&strm, 0, sizeof(strm));
+        if (BZ2_bzDecompressInit(&strm, /* verbosity */ 0, /* small */ 0) != BZ_OK)
+            CBP_FATAL("cannot initialize bzip2 decompression for %s", path.c_str());
+        strm_valid = true;
+    }
+
+    BZ2_INPUT::~BZ2_INPUT(void)
+    {
+        if (strm_valid)
+            BZ2_bzDecompressEnd(&strm);
+        if (file)
+            fclose(file);
+        delete [] in_buffer;
+        delete [] out_buffer;
+    }
+
+    // Decompresses up to 'size' bytes straight into 'dest'.  Returns the number of
+    // bytes produced; 0 means the end of the trace has been reached.  Concatenated
+    // bzip2 streams (as written by pbzip2, for example) are decoded back to back.
+    size_t
+    BZ2_INPUT::decompress(uint8_t* dest, size_t size)
+    {
+        strm.next_out = reinterpret_cast<char*>(dest);
+        strm.avail_out = static_cast<unsigned int>(size);
+
+        while (!at_eof && (strm.avail_out != 0)) {
+            if (strm.avail_in == 0) {
+                size_t n = fread(in_buffer, sizeof(uint8_t), IN_BUFFER_SIZE, file);
+                if (n == 0) {
+                    // a truncated trace just ends early, like a short pipe read did
+                    at_eof = true;
+                    break;
+                }
+                strm.next_in = reinterpret_cast<char*>(in_buffer);
+                strm.avail_in = static_cast<unsigned int>(n);
+            }
+
+            int rc = BZ2_bzDecompress(&strm);
+            if (rc == BZ_STREAM_END) {
+                // restart the decoder if another stream follows this one
+                char* next_in = strm.next_in;
+                unsigned int avail_in = strm.avail_in;
+                char* next_out = strm.next_out;
+                unsigned int avail_out = strm.avail_out;
+                BZ2_bzDecompressEnd(&strm);
+                memset(&strm, 0, sizeof(strm));
+                if (BZ2_bzDecompressInit(&strm, 0, 0) != BZ_OK)
+                    CBP_FATAL("cannot initialize bzip2 decompression for %s", path.c_str());
+                strm.next_in = next_in;
+                strm.avail_in = avail_in;
+                strm.next_out = next_out;
+                strm.avail_out = avail_out;
+                if ((avail_in == 0) && feof(file))
+                    at_eof = true;
+            } else if (rc != BZ_OK) {
+                fprintf(stderr, "warning: bzip2 error %d in %s; trace truncated\n", rc, path.c_str());
+                at_eof = true;
+            }
+        }
+
+        return (size - strm.avail_out);
+    }
+
+    size_t
+    BZ2_INPUT::read(void* dest_arg, size_t size)
+    {
+        uint8_t* dest = static_cast<uint8_t*>(dest_arg);
+        size_t done = 0;
+
+        while (done < size) {
+            size_t buffered = (out_tail - out_head);
+            if (buffered != 0) {
+                size_t n = min(buffered, size - done);
+                memcpy(dest + done, out_head, n);
+                out_head += n;
+                done += n;
+                continue;
+            }
+
+            // large requests bypass the buffer; small ones refill it
+            if ((size - done) >= OUT_BUFFER_SIZE) {
+                size_t n = decompress(dest + done, size - done);
+                done += n;
+                if (n == 0)
+                    break;
+            } else {
+                out_head = out_buffer;
+                out_tail = out_buffer + decompress(out_buffer, OUT_BUFFER_SIZE);
+                if (out_tail == out_head)
+                    break;
+            }
+        }
+
+        return done;
+    }
+
+    static const uint64_t BZ2_BLOCK_MAGIC = 0x314159265359ULL;   // BCD pi
+    static const uint64_t BZ2_EOS_MAGIC   = 0x177245385090ULL;   // BCD sqrt(pi)
+    static const uint64_t BZ2_MAGIC_MASK  = ((uint64_t(1) << 48) - 1);
+
+    // Appends bits, most significant first, to a byte vector.
+    class BZ2_BIT_WRITER
+    {
+      private:
+        vector<uint8_t>* out;
+        uint64_t acc;
+        int acc_bits;   // bits in 'acc' not yet written; always less than 8
+
+      public:
+        explicit BZ2_BIT_WRITER(vector<uint8_t>* out_arg) : out(out_arg), acc(0), acc_bits(0) { }
+
+        // appends the low 'count' bits of 'bits'; 'count' is at most 32
+        void put(uint32_t bits, int count)
+        {
+            acc = ((acc << count) | (bits & ((uint64_t(1) << count) - 1)));
+            acc_bits += count;
+            while (acc_bits >= 8) {
+                acc_bits -= 8;
+                out->push_back(static_cast<uint8_t>(acc >> acc_bits));
+            }
+        }
+
+        // copies bits [begin_bit, end_bit) of 'src'
+        void copy(const vector<uint8_t>& src, uint64_t begin_bit, uint64_t end_bit)
+        {
+            uint64_t bit = begin_bit;
+            while ((bit < end_bit) && (bit & 7)) {
+                put((src[bit >> 3] >> (7 - (bit & 7))) & 1, 1);
+                ++bit;
+            }
+            if (acc_bits == 0) {
+                for (; (bit + 8) <= end_bit; bit += 8)
+                    out->push_back(src[bit >> 3]);
+            } else {
+                for (; (bit + 8) <= end_bit; bit += 8)
+                    put(src[bit >> 3], 8);
+            }
+            for (; bit < end_bit; ++bit)
+                put((src[bit >> 3] >> (7 - (bit & 7))) & 1, 1);
+        }
+
+        void flush(void)
+        {
+            if (acc_bits != 0)
+                put(0, 8 - acc_bits);
+        }
+    };
+
+    BZ2_PARALLEL_INPUT::BZ2_PARALLEL_INPUT(const char* path_arg, unsigned num_threads)
+        : path(path_arg),
+          next_to_decode(0),
+          next_to_read(0),
+          max_ahead(2 * max(num_threads, 1u)),
+          stopping(false),
+          current_pos(0)
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file)
+            CBP_FATAL("cannot open trace file %s", path.c_str());
+        uint8_t chunk[1 << 16];
+        size_t n;
+        while ((n = fread(chunk, sizeof(uint8_t), sizeof(chunk), file)) > 0)
+            compressed.insert(compressed.end(), chunk, chunk + n);
+        fclose(file);
+
+        find_blocks();
+
+        for (unsigned i = 0; (i < num_threads) && !blocks.empty(); ++i)
+            workers.push_back(thread(&BZ2_PARALLEL_INPUT::worker, this));
+    }
+
+    BZ2_PARALLEL_INPUT::~BZ2_PARALLEL_INPUT(void)
+    {
+        {
+            lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        block_taken.notify_all();
+        for (size_t i = 0; i < workers.size(); ++i)
+            workers[i].join();
+    }
+
+    // Records every block magic in the file.  Each block runs up to the next
+    // block or end-of-stream magic.
+    void
+    BZ2_PARALLEL_INPUT::find_blocks(void)
+    {
+        uint64_t reg = 0;
+        uint64_t bits_seen = 0;
+        for (size_t i = 0; i < compressed.size(); ++i) {
+            reg = ((reg << 8) | compressed[i]);
+            bits_seen += 8;
+            // check the 8 alignments that end inside this byte, oldest first
+            for (int shift = 7; shift >= 0; --shift) {
+                if ((bits_seen - shift) < 48)
+                    continue;
+                uint64_t window = ((reg >> shift) & BZ2_MAGIC_MASK);
+                if ((window != BZ2_BLOCK_MAGIC) && (window != BZ2_EOS_MAGIC))
+                    continue;
+                uint64_t magic_bit = (bits_seen - shift - 48);
+                if (!blocks.empty() && (blocks.back().end_bit == 0))
+                    blocks.back().end_bit = magic_bit;
+                if (window == BZ2_BLOCK_MAGIC) {
+                    blocks.push_back(BLOCK());
+                    blocks.back().begin_bit = magic_bit;
+                }
+            }
+        }
+        // a truncated file: let the last block run to the end
+        if (!blocks.empty() && (blocks.back().end_bit == 0))
+            blocks.back().end_bit = (compressed.size() * 8);
+    }
+
+    // Decompresses blocks 'first' through 'last' as a single bzip2 stream.
+    // Returns true if the stream decoded without errors.
+    bool
+    BZ2_PARALLEL_INPUT::decode_range(size_t first, size_t last, vector<uint8_t>* out) const
+    {
+        uint64_t begin_bit = blocks[first].begin_bit;
+        uint64_t end_bit = blocks[last].end_bit;
+
+        // the block CRC follows the block magic; for a single-block stream the
+        // combined stream CRC is the same as the block CRC
+        uint32_t block_crc = 0;
+        for (uint64_t bit = begin_bit + 48; bit < (begin_bit + 80); ++bit)
+            block_crc = ((block_crc << 1) | ((compressed[bit >> 3] >> (7 - (bit & 7))) & 1));
+
+        // the block size in the header only bounds the decoder's allocation, so the
+        // largest one is always safe
+        vector<uint8_t> stream;
+        stream.reserve(((end_bit - begin_bit) / 8) + 16);
+        BZ2_BIT_WRITER writer(&stream);
+        writer.put('B', 8);
+        writer.put('Z', 8);
+        writer.put('h', 8);
+        writer.put('9', 8);
+        writer.copy(compressed, begin_bit, end_bit);
+        writer.put(static_cast<uint32_t>(BZ2_EOS_MAGIC >> 24), 24);
+        writer.put(static_cast<uint32_t>(BZ2_EOS_MAGIC & 0xffffff), 24);
+        writer.put(block_crc, 32);
+        writer.flush();
+
+        bz_stream strm;
+        memset(&strm, 0, sizeof(strm));
+        if (BZ2_bzDecompressInit(&strm, 0, 0) != BZ_OK)
+            return false;
+        strm.next_in = reinterpret_cast<char*>(&stream[0]);
+        strm.avail_in = static_cast<unsigned int>(stream.size());
+
+        out->clear();
+        size_t produced = 0;
+        int rc = BZ_OK;
+        while (rc == BZ_OK) {
+            if (out->size() - produced < (1 << 18))
+                out->resize(produced + (1 << 20));
+            strm.next_out = reinterpret_cast<char*>(&(*out)[produced]);
+            strm.avail_out = static_cast<unsigned int>(out->size() - produced);
+            unsigned int avail_in = strm.avail_in;
+            unsigned int avail_out = strm.avail_out;
+            rc = BZ2_bzDecompress(&strm);
+            produced += (avail_out - strm.avail_out);
+            if ((rc == BZ_OK) && (avail_in == strm.avail_in) && (avail_out == strm.avail_out))
+                break;   // no progress: the stream is truncated
+        }
+        BZ2_bzDecompressEnd(&strm);
+        out->resize(produced);
+
+        return (rc == BZ_STREAM_END);
+    }
+
+    void
+    BZ2_PARALLEL_INPUT::worker(void)
+    {
+        vector<uint8_t> data;
+        for (;;) {
+            size_t index;
+            {
+                unique_lock<std::mutex> lock(mutex);
+                while (!stopping && (next_to_decode < blocks.size())
+                    && (next_to_decode >= (next_to_read + max_ahead)))
+                    block_taken.wait(lock);
+                if (stopping || (next_to_decode >= blocks.size()))
+                    return;
+                index = next_to_decode++;
+            }
+
+            bool ok = decode_range(index, index, &data);
+
+            {
+                lock_guard<std::mutex> lock(mutex);
+                blocks[index].data.swap(data);
+                blocks[index].ok = ok;
+                blocks[index].done = true;
+            }
+            block_done.notify_all();
+            data.clear();
+        }
+    }
+
+    // Moves the next decoded block into 'current'.  Returns false at the end of
+    // the file.
+    bool
+    BZ2_PARALLEL_INPUT::next_block(void)
+    {
+        unique_lock<std::mutex> lock(mutex);
+        if (next_to_read >= blocks.size())
+            return false;
+        while (!blocks[next_to_read].done)
+            block_done.wait(lock);
+
+        size_t first = next_to_read;
+        current.swap(blocks[first].data);
+        vector<uint8_t>().swap(blocks[first].data);
+        current_pos = 0;
+        size_t last = first;
+
+        if (!blocks[first].ok) {
+            // the block was cut short by a false magic number; extend it over the
+            // following blocks until it decodes
+            lock.unlock();
+            bool ok = false;
+            while (!ok && (++last < blocks.size()))
+                ok = decode_range(first, last, &current);
+            lock.lock();
+            if (!ok) {
+                fprintf(stderr, "warning: bzip2 error in %s; trace truncated\n", path.c_str());
+                current.clear();
+                last = (blocks.size() - 1);
+            }
+            for (size_t i = first + 1; (i <= last) && (i < blocks.size()); ++i)
+                vector<uint8_t>().swap(blocks[i].data);
+        }
+
+        next_to_read = (last + 1);
+        lock.unlock();
+        block_taken.notify_all();
+        return true;
+    }
+
+    size_t
+    BZ2_PARALLEL_INPUT::read(void* dest_arg, size_t size)
+    {
+        uint8_t* dest = static_cast<uint8_t*>(dest_arg);
+        size_t done = 0;
+
+        while (done < size) {
+            if (current_pos == current.size()) {
+                if (!next_block())
+                    break;
+                continue;
+            }
+            size_t n = min(current.size() - current_pos, size - done);
+            memcpy(dest + done, &current[current_pos], n);
+            current_pos += n;
+            done += n;
+        }
+
+        return done;
+    }
+
+    CBP_INPUT*
+    bz2_input_open(const char* path, unsigned num_threads)
+    {
+        if (num_threads == 0)
+            num_threads = thread::hardware_concurrency();
+        if (num_threads > 1) {
+            BZ2_PARALLEL_INPUT* input = new BZ2_PARALLEL_INPUT(path, num_threads);
+            if (input->num_blocks() != 0)
+                return input;
+            delete input;   // not something we can split; let libbz2 report on it
+        }
+        return new BZ2_INPUT(path);
+    }
+
+    CBP_INPUT*
+    bz2_input_open_at(const char* path, uint64_t offset)
+    {
+        return new BZ2_INPUT(path, offset);
+    }
+} // namespace cbp
@@ -0,0 +1,125 @@
+/* Description: This file defines BZ2_INPUT, a CBP_INPUT that decompresses a
+ * bzip2-compressed trace in-process with libbz2, so the trace reader no longer
+ * needs an external bzip2 process and a pipe.  It also defines
+ * BZ2_PARALLEL_INPUT, which decompresses the blocks of a trace on a pool of
+ * threads.
+*/
+
+#ifndef BZ2_INPUT_H_SEEN
+#define BZ2_INPUT_H_SEEN
+
+#include <bzlib.h>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <inttypes.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cbp_inst.h"
+
+namespace cbp
+{
+    class BZ2_INPUT : public CBP_INPUT
+    {
+      private:
+        // not implemented
+        explicit BZ2_INPUT(const BZ2_INPUT&);
+        BZ2_INPUT& operator=(const BZ2_INPUT&);
+
+        // compressed bytes are read from 'file' into 'in_buffer'; decompressed
+        // bytes are produced into 'out_buffer', which small reads are served from
+        enum { IN_BUFFER_SIZE = (1 << 18) };
+        enum { OUT_BUFFER_SIZE = (1 << 20) };
+
+        std::string path;
+        std::FILE* file;
+        bz_stream strm;
+        bool strm_valid;
+        bool at_eof;
+        uint8_t* in_buffer;
+        uint8_t* out_buffer;
+        uint8_t* out_head;   // next decompressed byte to hand out
+        uint8_t* out_tail;   // one past the last decompressed byte
+
+        std::size_t decompress(uint8_t* dest, std::size_t size);
+
+      public:
+        // Opens 'path' (the complete file name, including any ".bz2") and starts
+        // decompressing at byte 'offset', which must be the start of a bzip2
+        // stream.  Calls CBP_FATAL if the file can't be opened.
+        explicit BZ2_INPUT(const char* path_arg, uint64_t offset = 0);
+        virtual ~BZ2_INPUT(void);
+
+        virtual std::size_t read(void* dest, std::size_t size);
+    };
+
+    // A bzip2 file is a sequence of independently compressed blocks, each of
+    // which starts with a 48-bit magic number that is not byte aligned.
+    // BZ2_PARALLEL_INPUT finds the block boundaries, rewraps each block as a
+    // complete single-block bzip2 stream, decompresses the blocks on a pool of
+    // worker threads, and hands the blocks back out in order.  The magic number
+    // can also occur by chance inside compressed data; a block that fails to
+    // decode is merged with the blocks after it until it decodes.
+    class BZ2_PARALLEL_INPUT : public CBP_INPUT
+    {
+      private:
+        // not implemented
+        explicit BZ2_PARALLEL_INPUT(const BZ2_PARALLEL_INPUT&);
+        BZ2_PARALLEL_INPUT& operator=(const BZ2_PARALLEL_INPUT&);
+
+        struct BLOCK
+        {
+            BLOCK(void) : begin_bit(0), end_bit(0), done(false), ok(false) { }
+            uint64_t begin_bit;            // first bit of the block magic
+            uint64_t end_bit;              // first bit after the block
+            bool done;                     // a worker has finished with the block
+            bool ok;                       // the block decoded cleanly
+            std::vector<uint8_t> data;     // the decompressed bytes
+        };
+
+        std::string path;
+        std::vector<uint8_t> compressed;   // the whole .bz2 file
+        std::vector<BLOCK> blocks;
+
+        std::mutex mutex;
+        std::condition_variable block_done;    // signalled by workers
+        std::condition_variable block_taken;   // signalled by the reader
+        std::vector<std::thread> workers;
+        std::size_t next_to_decode;        // next block a worker will pick up
+        std::size_t next_to_read;          // block the reader is waiting for/reading
+        std::size_t max_ahead;             // bounds the number of buffered blocks
+        bool stopping;
+
+        std::vector<uint8_t> current;      // block currently being read
+        std::size_t current_pos;
+
+        void find_blocks(void);
+        bool decode_range(std::size_t first, std::size_t last, std::vector<uint8_t>* out) const;
+        void worker(void);
+        bool next_block(void);
+
+      public:
+        // Opens 'path' and starts 'num_threads' decompression threads.  Calls
+        // CBP_FATAL if the file can't be read.
+        BZ2_PARALLEL_INPUT(const char* path_arg, unsigned num_threads);
+        virtual ~BZ2_PARALLEL_INPUT(void);
+
+        // number of bzip2 blocks found in the file; 0 if it isn't a bzip2 file
+        std::size_t num_blocks(void) const { return blocks.size(); }
+
+        virtual std::size_t read(void* dest, std::size_t size);
+    };
+
+    // Opens the bzip2 file 'path' with BZ2_PARALLEL_INPUT if 'num_threads' is
+    // greater than 1, and with BZ2_INPUT otherwise.  A 'num_threads' of 0 uses
+    // one thread per core.  The client deletes the returned CBP_INPUT.
+    CBP_INPUT* bz2_input_open(const char* path, unsigned num_threads);
+
+    // Opens the bzip2 file 'path' with BZ2_INPUT, starting at the bzip2 stream
+    // that begins at byte 'offset'.  The client deletes the returned CBP_INPUT.
+    CBP_INPUT* bz2_input_open_at(const char* path, uint64_t offset);
+} // namespace cbp
+
+#endif // BZ2_INPUT_H_SEEN
@@ -12,6 +12,7 @@
 #include <inttypes.h>
 #include <sstream>
 #include <string>
+#include <vector>
 #include "cbp_assert.h"
 #include "cbp_fatal.h"
 #include "cond_pred.h"
@@ -251,14 +252,26 @@ namespace cbp
         explicit CBP_INST_STREAM(const CBP_INST_STREAM&);
         CBP_INST_STREAM& operator=(const CBP_INST_STREAM&);
     
-        // the underlying stream
+        // the underlying stream; input streams may read from 'input' instead
         FILE* stream;
+        CBP_INPUT* input;
+        size_t read_bytes(uint8_t* dest, size_t size);
     
-        // input or output buffer
+        // output buffer
         enum { BUFFER_SIZE = 50 };     // size of largest io format CBP_INST
         uint8_t buffer[BUFFER_SIZE];
-        uint8_t* buffer_tail;
-        template <class Type> void get_buffer(Type* ptr);
+        uint8_t* buffer_tail;          // next byte to put
+
+        // Input is read from the underlying stream in large chunks into a window,
+        // and CBP_INSTs are decoded directly out of the window.  The window has
+        // WINDOW_SLACK bytes past WINDOW_SIZE that are never filled, so a patch
+        // can be read from any offset of the last record (see get_patch).
+        enum { WINDOW_SIZE = (1 << 20), WINDOW_SLACK = 4 };
+        vector<uint8_t> window;
+        uint8_t* window_head;          // next unread byte
+        uint8_t* window_tail;          // one past the last byte read
+        bool window_eof;               // the underlying stream has no more bytes
+        void refill_window(void);
         template <class Type> void put_buffer(const Type* ptr);
     
         // The key describes how to construct a CBP_INST.  Each member is either
@@ -299,6 +312,39 @@ namespace cbp
         static const KEY_TYPE UNUSED_KEY_BIT1       = (KEY_TYPE(0x1) << 13);
         static const KEY_TYPE UNUSED_KEY_BIT2       = (KEY_TYPE(0x1) << 14);
         static const KEY_TYPE UNUSED_KEY_BIT3       = (KEY_TYPE(0x1) << 15);
+
+        // The number of bytes that follow the key, and where each member's bytes
+        // are among them, are a function of the key alone, so they are looked up
+        // in a table indexed by the full 16-bit key (for 1-byte keys, the second
+        // byte is 0).  The members are encoded in the order of KEY_FIELD (the
+        // order the get functions are called); one the key leaves out has the
+        // offset it would have had.  The get functions read their bytes at their
+        // offsets, so none of them depends on how many bytes the others took, and
+        // the XOR patches are read and masked without testing the key.  The table
+        // is shared by all streams.
+        enum { KEY_TABLE_SIZE = (1 << 16) };
+        enum KEY_FIELD {
+            FIELD_INSTRUCTION_ADDR, FIELD_STATIC_INFO, FIELD_SRC1_VAL, FIELD_SRC2_VAL,
+            FIELD_DST_VAL, FIELD_VADDR1, FIELD_VADDR2, FIELD_BRANCH_TARGET, NUM_KEY_FIELDS
+        };
+        struct KEY_LAYOUT
+        {
+            uint8_t payload_size;
+            uint8_t offset[NUM_KEY_FIELDS];
+        };
+        struct KEY_TABLE
+        {
+            KEY_TABLE(void);
+            KEY_LAYOUT layout[KEY_TABLE_SIZE];
+        };
+        static void compute_layout(KEY_TYPE key_arg, KEY_LAYOUT* layout_arg);
+        static const KEY_TABLE& get_key_table(void);
+        const KEY_LAYOUT* key_layout;
+        const KEY_LAYOUT* layout;      // the layout of the CBP_INST being read
+        const uint8_t* payload;        // the bytes after its key, in the window
+        template <class Type> void get_field(Type* ptr, KEY_FIELD field) const;
+        uint32_t get_patch(KEY_FIELD field, KEY_TYPE read_bit) const;
+        template <class Type> static void get_static_info_member(const uint8_t** info, Type* ptr);
     
         // For each CBP_INST member, there is a pair of functions: a get function and
         // a put function.  When a CBP_INST is read, the get functions are called to
@@ -397,12 +443,23 @@ namespace cbp
         EVENT_COUNTER stat_read_src1_val;
         EVENT_COUNTER stat_read_vaddr2;
         void update_statistics(void);
+
+        // Every 'restart_interval' CBP_INSTs (if it isn't 0), all the state above
+        // goes back to how it was when the stream was constructed, so a trace can
+        // be decoded starting at any restart point.
+        uint64_t restart_interval;
+        uint64_t insts_since_restart;
+        void init_state(void);
+        void reset_state(void);
+        void check_restart(void);
     
       public:
-        CBP_INST_STREAM(FILE* stream_arg);
+        CBP_INST_STREAM(FILE* stream_arg, CBP_INPUT* input_arg);
         // uses compiler generated destructor
     
         FILE* get_stream(void) { return stream; }
+
+        void set_restart_interval(uint64_t interval) { restart_interval = interval; }
     
         // These functions return true on success and false on failure.
         bool read(CBP_INST* inst_arg);
@@ -411,12 +468,39 @@ namespace cbp
         string get_statistics_string(void) const;
     };
     
+    inline size_t
+    CBP_INST_STREAM::read_bytes(uint8_t* dest, size_t size)
+    {
+        if (input)
+            return input->read(dest, size);
+        return fread(dest, sizeof(uint8_t), size, stream);
+    }
+
     template <class Type>
     inline void
-    CBP_INST_STREAM::get_buffer(Type* ptr)
+    CBP_INST_STREAM::get_field(Type* ptr, KEY_FIELD field) const
     {
-        memcpy(ptr, buffer_tail, (sizeof(uint8_t) * NBYTE(Type)));
-        buffer_tail += NBYTE(Type);
+        memcpy(ptr, (payload + layout->offset[field]), (sizeof(uint8_t) * NBYTE(Type)));
+    }
+
+    template <class Type>
+    inline void
+    CBP_INST_STREAM::get_static_info_member(const uint8_t** info, Type* ptr)
+    {
+        memcpy(ptr, *info, (sizeof(uint8_t) * NBYTE(Type)));
+        *info += NBYTE(Type);
+    }
+
+    // The XOR patch of a member that has one if read_bit is set in the key, and
+    // 0 otherwise.  The 4 bytes at the member's offset are read either way (the
+    // offset is at most the end of the CBP_INST, and the window has slack past
+    // the last one), and masked.
+    inline uint32_t
+    CBP_INST_STREAM::get_patch(KEY_FIELD field, KEY_TYPE read_bit) const
+    {
+        uint32_t patch;
+        get_field(&patch, field);
+        return (patch & (uint32_t(0) - uint32_t(0 != (key & read_bit))));
     }
     
     template <class Type>
@@ -442,11 +526,7 @@ namespace cbp
     CBP_INST_STREAM::get_instruction_addr(void)
     {
         uint32_t instruction_addr = get_instruction_addr_prediction();
-        if (key & READ_INSTRUCTION_ADDR) {
-            uint32_t patch;
-            get_buffer(&patch);
-            instruction_addr ^= patch;
-        }
+        instruction_addr ^= get_patch(FIELD_INSTRUCTION_ADDR, READ_INSTRUCTION_ADDR);
         inst.instruction_addr = instruction_addr;
 
         // For non-branches, copy the instruction_addr field into the
@@ -486,18 +566,20 @@ namespace cbp
     {
         static_info = get_static_info_prediction(inst.instruction_addr);
         if (key & READ_STATIC_INFO) {
-            get_buffer(&static_info->src1);
-            get_buffer(&static_info->src2);
-            get_buffer(&static_info->dst);
-            get_buffer(&static_info->mem_src1);
-            get_buffer(&static_info->mem_src2);
-            get_buffer(&static_info->mem_src3);
+            // the static info is a run of members of its own, read in order
+            const uint8_t* info = (payload + layout->offset[FIELD_STATIC_INFO]);
+            get_static_info_member(&info, &static_info->src1);
+            get_static_info_member(&info, &static_info->src2);
+            get_static_info_member(&info, &static_info->dst);
+            get_static_info_member(&info, &static_info->mem_src1);
+            get_static_info_member(&info, &static_info->mem_src2);
+            get_static_info_member(&info, &static_info->mem_src3);
             STATIC_INFO::BIT_FIELD_TYPE bit_field_members;
-            get_buffer(&bit_field_members);
+            get_static_info_member(&info, &bit_field_members);
             static_info->set_bit_field_members(bit_field_members);
-            get_buffer(&static_info->instruction_addr);
-            get_buffer(&static_info->instruction_next_addr);
-            get_buffer(&static_info->branch_target);
+            get_static_info_member(&info, &static_info->instruction_addr);
+            get_static_info_member(&info, &static_info->instruction_next_addr);
+            get_static_info_member(&info, &static_info->branch_target);
         }
         static_info->fill(&inst);
     }
@@ -531,11 +613,7 @@ namespace cbp
     CBP_INST_STREAM::get_src1_val(void)
     {
         uint32_t* src1_val = &register_file[inst.src1];
-        if (key & READ_SRC1_VAL) {
-            uint32_t patch;
-            get_buffer(&patch);
-            *src1_val ^= patch;
-        }
+        *src1_val ^= get_patch(FIELD_SRC1_VAL, READ_SRC1_VAL);
         inst.src1_val = *src1_val;
     }
     
@@ -558,11 +636,7 @@ namespace cbp
     CBP_INST_STREAM::get_src2_val(void)
     {
         uint32_t* src2_val = &register_file[inst.src2];
-        if (key & READ_SRC2_VAL) {
-            uint32_t patch;
-            get_buffer(&patch);
-            *src2_val ^= patch;
-        }
+        *src2_val ^= get_patch(FIELD_SRC2_VAL, READ_SRC2_VAL);
         inst.src2_val = *src2_val;
     }
     
@@ -594,15 +668,15 @@ namespace cbp
                 dst_val = dst_val_stride_pred.get_prediction(inst.instruction_addr);
             break;
           case TYPE1_DST_VAL:   // 1 byte encoding
-            get_buffer(&output_l0_id);
+            get_field(&output_l0_id, FIELD_DST_VAL);
             dst_val = dst_val_l0[output_l0_id];
             break;
           case TYPE2_DST_VAL:   // 2 byte encoding
-            get_buffer(&output_l1_id);
+            get_field(&output_l1_id, FIELD_DST_VAL);
             dst_val = dst_val_l1[output_l1_id];
             break;
           case READ_DST_VAL:    // 4 byte encoding
-            get_buffer(&dst_val);
+            get_field(&dst_val, FIELD_DST_VAL);
             break;
           default:
             CBP_FATAL("invalid key");
@@ -691,15 +765,15 @@ namespace cbp
             vaddr1 = vaddr1_stride_pred.get_prediction(inst.instruction_addr);
             break;
           case TYPE1_VADDR1:   // 1 byte encoding
-            get_buffer(&output_l0_id);
+            get_field(&output_l0_id, FIELD_VADDR1);
             vaddr1 = vaddr1_l0[output_l0_id];
             break;
           case TYPE2_VADDR1:   // 2 byte encoding
-            get_buffer(&output_l1_id);
+            get_field(&output_l1_id, FIELD_VADDR1);
             vaddr1 = vaddr1_l1[output_l1_id];
             break;
           case READ_VADDR1:    // 4 byte encoding
-            get_buffer(&vaddr1);
+            get_field(&vaddr1, FIELD_VADDR1);
             break;
           default:
             CBP_FATAL("invalid key");
@@ -766,11 +840,7 @@ namespace cbp
     CBP_INST_STREAM::get_vaddr2(void)
     {
         uint32_t vaddr2 = /* vaddr1 */ inst.src_vaddr;
-        if (key & READ_VADDR2) {
-            uint32_t patch;
-            get_buffer(&patch);
-            vaddr2 ^= patch;
-        }
+        vaddr2 ^= get_patch(FIELD_VADDR2, READ_VADDR2);
         return vaddr2;
     }
     
@@ -917,15 +987,15 @@ namespace cbp
             branch_target = get_branch_target_prediction();
             break;
           case TYPE1_BRANCH_TARGET:   // 1 byte encoding
-            get_buffer(&output_l0_id);
+            get_field(&output_l0_id, FIELD_BRANCH_TARGET);
             branch_target = branch_target_l0[output_l0_id];
             break;
           case TYPE2_BRANCH_TARGET:   // 2 byte encoding
-            get_buffer(&output_l1_id);
+            get_field(&output_l1_id, FIELD_BRANCH_TARGET);
             branch_target = branch_target_l1[output_l1_id];
             break;
           case READ_BRANCH_TARGET:    // 4 byte encoding
-            get_buffer(&patch);
+            get_field(&patch, FIELD_BRANCH_TARGET);
             branch_target = (inst.instruction_addr ^ patch);
             break;
           default:
@@ -1057,8 +1127,16 @@ namespace cbp
     }
     
     inline
-    CBP_INST_STREAM::CBP_INST_STREAM(FILE* stream_arg)
+    CBP_INST_STREAM::CBP_INST_STREAM(FILE* stream_arg, CBP_INPUT* input_arg)
         : stream(stream_arg),
+          input(input_arg),
+          window(WINDOW_SIZE + WINDOW_SLACK),
+          window_head(0),
+          window_tail(0),
+          window_eof(false),
+          key_layout(get_key_table().layout),
+          layout(0),
+          payload(0),
           stat_cbp_inst(0),
           stat_two_byte_key(0),
           stat_type0_dst_val(0),
@@ -1078,7 +1156,19 @@ namespace cbp
           stat_type2_branch_target(0),
           stat_read_branch_target(0),
           stat_read_src1_val(0),
-          stat_read_vaddr2(0)
+          stat_read_vaddr2(0),
+          restart_interval(0),
+          insts_since_restart(0)
+    {
+        init_state();
+        window_head = &window[0];
+        window_tail = window_head;
+    }
+
+    // Sets up the state that the constructors of the predictors and caches
+    // don't.
+    void
+    CBP_INST_STREAM::init_state(void)
     {
         inst.instruction_addr = 0;
         inst.instruction_next_addr = 0;
@@ -1112,109 +1202,181 @@ namespace cbp
         static_info = get_static_info_prediction(inst.instruction_addr);
         fill_n(register_file, static_cast<size_t>(REG_MAX), 0);
     }
-    
-    inline bool
-    CBP_INST_STREAM::read(CBP_INST* inst_arg)
+
+    void
+    CBP_INST_STREAM::reset_state(void)
     {
-        size_t bytes_needed;
-    
-        // read the first byte
-        if (fread(&buffer[0], sizeof(uint8_t), 1, stream) != 1)
-            return /* failure */ false;
-    
-        // get the first byte of the key
-        key = buffer[0];
+        fill_n(static_info_cache, static_cast<size_t>(STATIC_INFO_CACHE_SIZE), STATIC_INFO());
+        dst_val_stride_pred.reset();
+        dst_val_l0.reset();
+        dst_val_l1.reset();
+        vaddr1_stride_pred.reset();
+        vaddr1_l0.reset();
+        vaddr1_l1.reset();
+        taken_cond_pred.reset();
+        branch_target_ret_pred.reset();
+        branch_target_ind_pred.reset();
+        branch_target_l0.reset();
+        branch_target_l1.reset();
+        init_state();
+    }
+
+    // Called before each CBP_INST is read or written.
+    inline void
+    CBP_INST_STREAM::check_restart(void)
+    {
+        if (restart_interval == 0)
+            return;
+        if (insts_since_restart == restart_interval) {
+            reset_state();
+            insts_since_restart = 0;
+        }
+        ++insts_since_restart;
+    }
     
-        // compute the number of extra bytes needed for the first byte of the key
-        bytes_needed = ((key & TWO_BYTE_KEY) ? 1 : 0);
-        switch (MASK_DST_VAL & key) {
+    // Computes the number of bytes that follow the key byte(s) of an encoded
+    // CBP_INST with key 'key_arg', and the offset among them of each member's
+    // bytes.  This is only called to fill in KEY_TABLE.
+    void
+    CBP_INST_STREAM::compute_layout(KEY_TYPE key_arg, KEY_LAYOUT* layout_arg)
+    {
+        size_t field_size[NUM_KEY_FIELDS] = { 0 };
+
+        // the second byte of the key is only present if TWO_BYTE_KEY is set
+        if (/* 1-byte key */ (0 == (TWO_BYTE_KEY & key_arg)))
+            key_arg &= 0xff;
+
+        // bytes needed for the first byte of the key
+        switch (MASK_DST_VAL & key_arg) {
           case TYPE0_DST_VAL:   // 0 byte encoding
             break;
           case TYPE1_DST_VAL:   // 1 byte encoding
-            bytes_needed += NBYTE(uint8_t);
+            field_size[FIELD_DST_VAL] = NBYTE(uint8_t);
             break;
           case TYPE2_DST_VAL:   // 2 byte encoding
-            bytes_needed += NBYTE(uint16_t);
+            field_size[FIELD_DST_VAL] = NBYTE(uint16_t);
             break;
           case READ_DST_VAL:    // 4 byte encoding
-            bytes_needed += NBYTE(inst.dst_val);
-            break;
-          default:
-            CBP_FATAL("invalid key");
+            field_size[FIELD_DST_VAL] = NBYTE(uint32_t);
             break;
         }
-        switch (MASK_VADDR1 & key) {
+        switch (MASK_VADDR1 & key_arg) {
           case TYPE0_VADDR1:   // 0 byte encoding
             break;
           case TYPE1_VADDR1:   // 1 byte encoding
-            bytes_needed += NBYTE(uint8_t);
+            field_size[FIELD_VADDR1] = NBYTE(uint8_t);
             break;
           case TYPE2_VADDR1:   // 2 byte encoding
-            bytes_needed += NBYTE(uint16_t);
+            field_size[FIELD_VADDR1] = NBYTE(uint16_t);
             break;
           case READ_VADDR1:    // 4 byte encoding
-            bytes_needed += NBYTE(inst.src_vaddr);
-            break;
-          default:
-            CBP_FATAL("invalid key");
+            field_size[FIELD_VADDR1] = NBYTE(uint32_t);
             break;
         }
-        bytes_needed += ((READ_SRC2_VAL & key) ? NBYTE(inst.src2_val) : 0);
+        field_size[FIELD_SRC2_VAL] = ((READ_SRC2_VAL & key_arg) ? NBYTE(uint32_t) : 0);
         static const size_t STATIC_INFO_SIZE = (0
-            + NBYTE(static_info->src1)
-            + NBYTE(static_info->src2)
-            + NBYTE(static_info->dst)
-            + NBYTE(static_info->mem_src1)
-            + NBYTE(static_info->mem_src2)
-            + NBYTE(static_info->mem_src3)
+            + NBYTE(uint8_t)    // src1
+            + NBYTE(uint8_t)    // src2
+            + NBYTE(uint8_t)    // dst
+            + NBYTE(uint8_t)    // mem_src1
+            + NBYTE(uint8_t)    // mem_src2
+            + NBYTE(uint8_t)    // mem_src3
             + NBYTE(STATIC_INFO::BIT_FIELD_TYPE)
-            + NBYTE(static_info->instruction_addr)
-            + NBYTE(static_info->instruction_next_addr)
-            + NBYTE(static_info->branch_target));
-        bytes_needed += ((key & READ_STATIC_INFO) ? STATIC_INFO_SIZE : 0);
-    
-        // read the extra bytes needed for the first byte of the key
-        if (fread(&buffer[1], sizeof(uint8_t), bytes_needed, stream) != bytes_needed)
-            return /* failure */ false;
-    
-        // if the key is only one byte, we're done--go get the instruction
-        if (/* 1-byte key */ (0 == (TWO_BYTE_KEY & key)))
-            goto get_cbp_inst; 
-    
-        // get the second byte of the key
-        key |= (KEY_TYPE(buffer[1]) << 8);
-    
-        // store the current buffer position in buffer_tail
-        buffer_tail = (&buffer[1] + bytes_needed);
-    
-        // compute the number of extra bytes needed for the second byte of the key
-        bytes_needed = ((READ_INSTRUCTION_ADDR & key) ? NBYTE(inst.instruction_addr) : 0);
-        switch (MASK_BRANCH_TARGET & key) {
+            + NBYTE(uint32_t)   // instruction_addr
+            + NBYTE(uint32_t)   // instruction_next_addr
+            + NBYTE(uint32_t)); // branch_target
+        field_size[FIELD_STATIC_INFO] = ((key_arg & READ_STATIC_INFO) ? STATIC_INFO_SIZE : 0);
+
+        // bytes needed for the second byte of the key
+        field_size[FIELD_INSTRUCTION_ADDR] = ((READ_INSTRUCTION_ADDR & key_arg) ? NBYTE(uint32_t) : 0);
+        switch (MASK_BRANCH_TARGET & key_arg) {
           case TYPE0_BRANCH_TARGET:   // 0 byte encoding
             break;
           case TYPE1_BRANCH_TARGET:   // 1 byte encoding
-            bytes_needed += NBYTE(uint8_t);
+            field_size[FIELD_BRANCH_TARGET] = NBYTE(uint8_t);
             break;
           case TYPE2_BRANCH_TARGET:   // 2 byte encoding
-            bytes_needed += NBYTE(uint16_t);
+            field_size[FIELD_BRANCH_TARGET] = NBYTE(uint16_t);
             break;
           case READ_BRANCH_TARGET:    // 4 byte encoding
-            bytes_needed += NBYTE(inst.branch_target);
-            break;
-          default:
-            CBP_FATAL("invalid key");
+            field_size[FIELD_BRANCH_TARGET] = NBYTE(uint32_t);
             break;
         }
-        bytes_needed += ((READ_SRC1_VAL & key) ? NBYTE(inst.src1_val) : 0);
-        bytes_needed += ((READ_VADDR2 & key) ? NBYTE(inst.dst_vaddr) : 0);
-    
-        // read the extra bytes needed for the second byte of the key
-        if (fread(buffer_tail, sizeof(uint8_t), bytes_needed, stream) != bytes_needed)
+        field_size[FIELD_SRC1_VAL] = ((READ_SRC1_VAL & key_arg) ? NBYTE(uint32_t) : 0);
+        field_size[FIELD_VADDR2] = ((READ_VADDR2 & key_arg) ? NBYTE(uint32_t) : 0);
+
+        // the members follow each other in the order of KEY_FIELD
+        size_t bytes_needed = 0;
+        for (size_t f = 0; f < NUM_KEY_FIELDS; ++f) {
+            layout_arg->offset[f] = static_cast<uint8_t>(bytes_needed);
+            bytes_needed += field_size[f];
+        }
+        CBP_ASSERT(bytes_needed + 2 <= BUFFER_SIZE);
+        layout_arg->payload_size = static_cast<uint8_t>(bytes_needed);
+    }
+
+    CBP_INST_STREAM::KEY_TABLE::KEY_TABLE(void)
+    {
+        for (size_t k = 0; k < KEY_TABLE_SIZE; ++k)
+            compute_layout(static_cast<KEY_TYPE>(k), &layout[k]);
+    }
+
+    const CBP_INST_STREAM::KEY_TABLE&
+    CBP_INST_STREAM::get_key_table(void)
+    {
+        static const KEY_TABLE key_table;
+        return key_table;
+    }
+
+    // Moves the unread bytes to the front of the window and fills the rest of
+    // it from the underlying stream.
+    void
+    CBP_INST_STREAM::refill_window(void)
+    {
+        size_t unread = (window_tail - window_head);
+        uint8_t* window_base = &window[0];
+        memmove(window_base, window_head, unread);
+        window_head = window_base;
+        window_tail = window_base + unread;
+        if (window_eof)
+            return;
+        size_t space = (WINDOW_SIZE - unread);
+        size_t n = read_bytes(window_tail, space);
+        window_tail += n;
+        if (n < space)
+            window_eof = true;
+    }
+
+    inline bool
+    CBP_INST_STREAM::read(CBP_INST* inst_arg)
+    {
+        // make sure the window holds the largest possible encoded CBP_INST
+        if ((window_tail - window_head) < BUFFER_SIZE)
+            refill_window();
+        size_t bytes_available = (window_tail - window_head);
+        if (bytes_available == 0)
             return /* failure */ false;
-    
-      get_cbp_inst:
-        buffer_tail = ((TWO_BYTE_KEY & key) ? &buffer[2] : &buffer[1]);
-    
+
+        // get the key; the second byte is only present if TWO_BYTE_KEY is set
+        key = window_head[0];
+        size_t key_size = 1;
+        if (TWO_BYTE_KEY & key) {
+            if (bytes_available < 2)
+                return /* failure */ false;
+            key |= (KEY_TYPE(window_head[1]) << 8);
+            key_size = 2;
+        }
+
+        // the key table gives the number of bytes encoded after the key, and
+        // where each member is among them
+        layout = &key_layout[key];
+        size_t record_size = (key_size + layout->payload_size);
+        if (record_size > bytes_available)
+            return /* failure */ false;
+        payload = (window_head + key_size);
+        window_head += record_size;
+
+        check_restart();
         get_instruction_addr();
         get_static_info();
         get_src1_val();
@@ -1235,6 +1397,7 @@ namespace cbp
     inline bool
     CBP_INST_STREAM::write(const CBP_INST* inst_arg)
     {
+        check_restart();
         buffer_tail = &buffer[2];   // leave room for the key
         key = 0;
         output_inst = inst_arg;
@@ -1314,7 +1477,13 @@ namespace cbp
     CBP_INST_STREAM*
     cbp_inst_open(FILE* stream)
     {
-        return new CBP_INST_STREAM(stream);
+        return new CBP_INST_STREAM(stream, 0);
+    }
+
+    CBP_INST_STREAM*
+    cbp_inst_open(CBP_INPUT* input)
+    {
+        return new CBP_INST_STREAM(0, input);
     }
     
     FILE*
@@ -1325,6 +1494,12 @@ namespace cbp
         return return_value;
     }
     
+    void
+    cbp_inst_set_restart_interval(CBP_INST_STREAM* stream, uint64_t interval)
+    {
+        stream->set_restart_interval(interval);
+    }
+
     bool
     cbp_inst_read(CBP_INST_STREAM* stream, CBP_INST* inst)
     {
@@ -7,6 +7,7 @@
 #ifndef CBP_INST_H_SEEN
 #define CBP_INST_H_SEEN
 
+#include <cstddef>
 #include <cstdio>
 #include <inttypes.h>
 
@@ -71,6 +72,18 @@ namespace cbp
         bool taken;                       // (BRANCH ONLY) false if not-taken conditional branch; true for all other branches
     };
     
+    // This type supplies the raw bytes of a trace to an input CBP_INST_STREAM
+    // without going through a std::FILE*; see bz2_input.h for an example.
+    class CBP_INPUT
+    {
+      public:
+        virtual ~CBP_INPUT(void) { }
+
+        // Reads up to 'size' bytes into 'dest' and returns the number of bytes
+        // read.  Returning less than 'size' means the end of the trace was reached.
+        virtual std::size_t read(void* dest, std::size_t size) = 0;
+    };
+
     // This type controls a stream of CBP_INST structures.  The stream can be
     // used for either input or output, but not both.
     struct CBP_INST_STREAM;
@@ -78,11 +91,23 @@ namespace cbp
     // Constructs a CBP_INST_STREAM from open std::FILE* 'stream' and returns a
     // pointer to it.
     CBP_INST_STREAM* cbp_inst_open(std::FILE* stream);
-    
-    // Destructs 'stream'.  Returns the std::FILE* that was used to construct 'stream'.
-    // It is the client's responsibility to close this std::FILE*.
+
+    // Constructs an input CBP_INST_STREAM that reads from 'input' and returns a
+    // pointer to it.  It is the client's responsibility to delete 'input' after
+    // the stream is closed.
+    CBP_INST_STREAM* cbp_inst_open(CBP_INPUT* input);
+    
+    // Destructs 'stream'.  Returns the std::FILE* that was used to construct 'stream',
+    // or 0 if it was constructed from a CBP_INPUT.  It is the client's responsibility
+    // to close this std::FILE*.
     std::FILE* cbp_inst_close(CBP_INST_STREAM* stream);
     
+    // Makes 'stream' reset all of its adaptive state every 'interval' CBP_INSTs,
+    // so the CBP_INSTs after each reset can be decoded without the ones before
+    // it.  An interval of 0 (the default) never resets.  A trace must be read
+    // with the interval it was written with; see trace_index.h.
+    void cbp_inst_set_restart_interval(CBP_INST_STREAM* stream, uint64_t interval);
+
     // Reads 'inst' from 'stream'.  Returns true on success and false on failure.
     bool cbp_inst_read(CBP_INST_STREAM* stream, CBP_INST* inst);
     
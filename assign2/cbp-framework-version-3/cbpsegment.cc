@@ -0,0 +1,122 @@
+/* Description: Re-encodes a CBP trace as a segmented trace: the CBP_INST
+ * stream restarts from its initial state every N instructions, each segment
+ * is compressed as its own bzip2 stream, and an index (.idx) records where
+ * each segment starts.  The result is still one .bz2 file, but the trace
+ * reader can start at any segment or decode several segments at once.
+*/
+
+#include <bzlib.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "bz2_input.h"
+#include "cbp_inst.h"
+#include "trace_index.h"
+
+static const unsigned long long DEFAULT_INTERVAL = 1000000;
+
+static void
+usage(const char* prog)
+{
+    printf("usage: %s [--interval=N] [--decode-threads=N] <trace> <output>\n", prog);
+    printf("  reads <trace>.bz2 and writes <output>.bz2 and its index <output>.idx, restarting\n");
+    printf("  every N instructions (default: %llu)\n", DEFAULT_INTERVAL);
+    exit(EXIT_FAILURE);
+}
+
+// compresses one segment's encoded bytes onto the end of 'file' as a complete bzip2 stream
+static void
+write_segment(std::FILE* file, const char* file_name, const char* bytes, size_t size)
+{
+    int bzerror;
+    BZFILE* bz = BZ2_bzWriteOpen(&bzerror, file, /* block size */ 9, /* verbosity */ 0, /* work factor */ 0);
+    if (bzerror == BZ_OK && size != 0) {
+        BZ2_bzWrite(&bzerror, bz, const_cast<char*>(bytes), static_cast<int>(size));
+    }
+    int write_error = bzerror;
+    BZ2_bzWriteClose(&bzerror, bz, /* abandon */ (write_error != BZ_OK), 0, 0);
+    if (write_error != BZ_OK || bzerror != BZ_OK) {
+        fprintf(stderr, "error writing %s\n", file_name);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// usage: cbpsegment [--interval=N] [--decode-threads=N] <trace> <output>
+int
+main(int argc, char* argv[])
+{
+    using namespace std;
+    using namespace cbp;
+
+    unsigned long long interval = DEFAULT_INTERVAL;
+    unsigned decode_threads = 0;
+    const char* trace_name = 0;
+    const char* output_name = 0;
+    for (int i = 1; i < argc; i++) {
+        if (0 == strncmp(argv[i], "--interval=", 11)) {
+            interval = strtoull(argv[i] + 11, 0, 10);
+        } else if (0 == strncmp(argv[i], "--decode-threads=", 17)) {
+            decode_threads = atoi(argv[i] + 17);
+        } else if (('-' != argv[i][0]) && !trace_name) {
+            trace_name = argv[i];
+        } else if (('-' != argv[i][0]) && !output_name) {
+            output_name = argv[i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (!trace_name || !output_name || interval == 0) {
+        usage(argv[0]);
+    }
+
+    string trace_file_name = string(trace_name) + ".bz2";
+    string output_file_name = string(output_name) + ".bz2";
+    string index_file_name = string(output_name) + ".idx";
+
+    CBP_INPUT* input = bz2_input_open(trace_file_name.c_str(), decode_threads);
+    CBP_INST_STREAM* in_stream = cbp_inst_open(input);
+    FILE* output = fopen(output_file_name.c_str(), "wb");
+    if (!output) {
+        fprintf(stderr, "cannot create %s\n", output_file_name.c_str());
+        exit(EXIT_FAILURE);
+    }
+
+    // each segment is encoded into memory by a fresh CBP_INST_STREAM, which starts in the
+    // same state that a reader restarts to, and then compressed onto the output
+    trace_index_c index;
+    index.restart_interval = interval;
+    CBP_INST inst;
+    bool more = cbp_inst_read(in_stream, &inst);
+    while (more) {
+        char* bytes = 0;
+        size_t size = 0;
+        FILE* segment_file = open_memstream(&bytes, &size);
+        CBP_INST_STREAM* out_stream = cbp_inst_open(segment_file);
+        trace_segment_c segment;
+        segment.offset = ftello(output);
+        segment.num_insts = 0;
+        while (more && segment.num_insts < interval) {
+            if (!cbp_inst_write(out_stream, &inst)) {
+                fprintf(stderr, "error encoding %s\n", output_file_name.c_str());
+                exit(EXIT_FAILURE);
+            }
+            segment.num_insts++;
+            more = cbp_inst_read(in_stream, &inst);
+        }
+        cbp_inst_close(out_stream);
+        fclose(segment_file);
+        write_segment(output, output_file_name.c_str(), bytes, size);
+        free(bytes);
+        index.segments.push_back(segment);
+    }
+    if (fclose(output) != 0) {
+        fprintf(stderr, "error writing %s\n", output_file_name.c_str());
+        exit(EXIT_FAILURE);
+    }
+    index.save(index_file_name.c_str());
+
+    cbp_inst_close(in_stream);
+    delete input;
+    return 0;
+}
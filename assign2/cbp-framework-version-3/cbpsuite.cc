@@ -0,0 +1,352 @@
+/* Description: Runs the predictor over the distributed traces and generates
+ * the report of the mispredict rates.  The (trace, configuration) jobs run
+ * in parallel on a pool of threads, largest trace first.  The report has the
+ * layout of the file BASELINE; the results, wall time and branches per
+ * second of each job can also be written as CSV and JSON.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static const char* const TRACE_LIST[] = {
+    "DIST-FP-1", "DIST-FP-2", "DIST-FP-3", "DIST-FP-4", "DIST-FP-5",
+    "DIST-INT-1", "DIST-INT-2", "DIST-INT-3", "DIST-INT-4", "DIST-INT-5",
+    "DIST-MM-1", "DIST-MM-2", "DIST-MM-3", "DIST-MM-4", "DIST-MM-5",
+    "DIST-SERV-1", "DIST-SERV-2", "DIST-SERV-3", "DIST-SERV-4", "DIST-SERV-5"
+};
+
+// one run of the predictor on one trace
+class suite_job_c
+{
+public:
+    suite_job_c() : trace_size(0), ran(false), status(0), mis_preds(0), insts(0), mis_pred_rate(0),
+                    branches(0), cc_branches(0), wall_seconds(0) {}
+    std::string trace;                 // name from TRACE_LIST
+    std::string trace_path;            // path given to the predictor
+    std::string config;                // extra predictor arguments, separated by spaces
+    long long trace_size;              // bytes in the trace file; -1 if it doesn't exist
+    bool ran;
+    int status;                        // exit status of the predictor
+    std::string output;                // everything the predictor printed
+    long long mis_preds;
+    long long insts;
+    double mis_pred_rate;
+    long long branches;
+    long long cc_branches;
+    double wall_seconds;
+};
+
+static void
+usage(const char* prog)
+{
+    printf("usage: %s [options] [ with-values | without-values ]\n", prog);
+    printf("  --jobs=N          run N predictors at once (default: one per core)\n");
+    printf("  --predictor=PATH  the predictor to run (default: ./predictor)\n");
+    printf("  --config=ARGS     run every trace with these predictor arguments; may be repeated\n");
+    printf("  --traces=A,B,...  run only these traces\n");
+    printf("  --csv=FILE        also write the results as CSV\n");
+    printf("  --json=FILE       also write the results as JSON\n");
+    exit(EXIT_FAILURE);
+}
+
+static std::vector<std::string>
+split(const std::string& s, char sep)
+{
+    std::vector<std::string> parts;
+    size_t begin = 0;
+    while (begin <= s.size()) {
+        size_t end = s.find(sep, begin);
+        if (end == std::string::npos)
+            end = s.size();
+        if (end != begin)
+            parts.push_back(s.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    return parts;
+}
+
+// runs 'args' with its standard output captured in 'output'; returns the exit status.  Other
+// threads may hold the allocator's locks when the child is forked, so everything the child needs
+// is built beforehand and it makes only async-signal-safe calls.
+static int
+run_command(const std::vector<std::string>& args, std::string* output)
+{
+    std::vector<char*> argv;
+    for (size_t i = 0; i < args.size(); i++)
+        argv.push_back(const_cast<char*>(args[i].c_str()));
+    argv.push_back(0);
+    std::string exec_failed = "cannot run " + args[0] + "\n";
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        execv(argv[0], &argv[0]);
+        ssize_t written = write(STDERR_FILENO, exec_failed.data(), exec_failed.size());
+        (void)written;
+        _exit(127);
+    }
+    close(fds[1]);
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fds[0], buffer, sizeof(buffer))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        output->append(buffer, n);
+    }
+    close(fds[0]);
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR)
+            return -1;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// picks the statistics out of the predictor's report
+static void
+parse_output(suite_job_c* job)
+{
+    const char* out = job->output.c_str();
+    const char* line;
+    if ((line = strstr(out, "1000*wrong_cc_predicts/total insts:")) != 0)
+        sscanf(line, "1000*wrong_cc_predicts/total insts: 1000 * %lld / %lld = %lf",
+               &job->mis_preds, &job->insts, &job->mis_pred_rate);
+    if ((line = strstr(out, "total branches:")) != 0)
+        sscanf(line, "total branches: %lld", &job->branches);
+    if ((line = strstr(out, "total cc branches:")) != 0)
+        sscanf(line, "total cc branches: %lld", &job->cc_branches);
+}
+
+// runs one job; unless its configuration says otherwise, the predictor decodes the trace on
+// decode_threads threads, so the jobs running at once share the cores instead of each taking all
+static void
+run_job(const std::string& predictor, unsigned decode_threads, suite_job_c* job)
+{
+    std::vector<std::string> args;
+    args.push_back(predictor);
+    std::vector<std::string> config_args = split(job->config, ' ');
+    bool sets_decode_threads = false;
+    for (size_t i = 0; i < config_args.size(); i++)
+        sets_decode_threads = sets_decode_threads || (0 == config_args[i].compare(0, 17, "--decode-threads="));
+    if (!sets_decode_threads)
+        args.push_back("--decode-threads=" + std::to_string(decode_threads));
+    args.insert(args.end(), config_args.begin(), config_args.end());
+    args.push_back(job->trace_path);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    job->status = run_command(args, &job->output);
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    job->wall_seconds = std::chrono::duration<double>(end - start).count();
+    job->ran = true;
+    parse_output(job);
+}
+
+static std::string
+json_string(const std::string& s)
+{
+    std::string quoted = "\"";
+    for (size_t i = 0; i < s.size(); i++) {
+        char c = s[i];
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (c == '\n') {
+            quoted += "\\n";
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+// a CSV field, quoted, with its quotes doubled
+static std::string
+csv_string(const std::string& s)
+{
+    std::string quoted = "\"";
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '"')
+            quoted += '"';
+        quoted += s[i];
+    }
+    return quoted + "\"";
+}
+
+static double
+branches_per_second(const suite_job_c& job)
+{
+    return (job.wall_seconds > 0) ? (job.branches / job.wall_seconds) : 0;
+}
+
+static void
+write_csv(const char* path, const std::vector<suite_job_c>& jobs)
+{
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "cannot create %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(file, "trace,config,status,mispredicts,insts,mpki,branches,cc_branches,wall_seconds,branches_per_second\n");
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const suite_job_c& job = jobs[i];
+        if (!job.ran)
+            continue;
+        fprintf(file, "%s,%s,%d,%lld,%lld,%.3f,%lld,%lld,%.3f,%.0f\n",
+                csv_string(job.trace).c_str(), csv_string(job.config).c_str(), job.status, job.mis_preds, job.insts,
+                job.mis_pred_rate, job.branches, job.cc_branches, job.wall_seconds, branches_per_second(job));
+    }
+    fclose(file);
+}
+
+static void
+write_json(const char* path, const std::vector<suite_job_c>& jobs)
+{
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "cannot create %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(file, "[\n");
+    bool first = true;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const suite_job_c& job = jobs[i];
+        if (!job.ran)
+            continue;
+        fprintf(file, "%s  {\"trace\": %s, \"config\": %s, \"status\": %d, \"mispredicts\": %lld, "
+                "\"insts\": %lld, \"mpki\": %.3f, \"branches\": %lld, \"cc_branches\": %lld, "
+                "\"wall_seconds\": %.3f, \"branches_per_second\": %.0f}",
+                first ? "" : ",\n", json_string(job.trace).c_str(), json_string(job.config).c_str(),
+                job.status, job.mis_preds, job.insts, job.mis_pred_rate, job.branches, job.cc_branches,
+                job.wall_seconds, branches_per_second(job));
+        first = false;
+    }
+    fprintf(file, "\n]\n");
+    fclose(file);
+}
+
+// usage: cbpsuite [options] [ with-values | without-values ]
+int
+main(int argc, char* argv[])
+{
+    using namespace std;
+
+    unsigned num_cores = max(1u, thread::hardware_concurrency());
+    unsigned num_jobs = num_cores;
+    string predictor = "./predictor";
+    string trace_type = "without-values";
+    vector<string> configs;
+    vector<string> traces(TRACE_LIST, TRACE_LIST + sizeof(TRACE_LIST) / sizeof(TRACE_LIST[0]));
+    const char* csv_name = 0;
+    const char* json_name = 0;
+    for (int i = 1; i < argc; i++) {
+        if (0 == strncmp(argv[i], "--jobs=", 7)) {
+            num_jobs = atoi(argv[i] + 7);
+        } else if (0 == strncmp(argv[i], "--predictor=", 12)) {
+            predictor = argv[i] + 12;
+        } else if (0 == strncmp(argv[i], "--config=", 9)) {
+            configs.push_back(argv[i] + 9);
+        } else if (0 == strncmp(argv[i], "--traces=", 9)) {
+            traces = split(argv[i] + 9, ',');
+        } else if (0 == strncmp(argv[i], "--csv=", 6)) {
+            csv_name = argv[i] + 6;
+        } else if (0 == strncmp(argv[i], "--json=", 7)) {
+            json_name = argv[i] + 7;
+        } else if (0 == strcmp(argv[i], "with-values") || 0 == strcmp(argv[i], "without-values")) {
+            trace_type = argv[i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (num_jobs == 0)
+        num_jobs = 1;
+    if (configs.empty())
+        configs.push_back("");
+
+    // the jobs are kept in report order; they run in order of decreasing trace size
+    vector<suite_job_c> jobs;
+    for (size_t c = 0; c < configs.size(); c++) {
+        for (size_t t = 0; t < traces.size(); t++) {
+            suite_job_c job;
+            job.trace = traces[t];
+            job.trace_path = "traces/" + trace_type + "/" + traces[t];
+            job.config = configs[c];
+            struct stat st;
+            job.trace_size = (stat((job.trace_path + ".bz2").c_str(), &st) == 0) ? st.st_size : -1;
+            jobs.push_back(job);
+        }
+    }
+    vector<size_t> order;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (jobs[i].trace_size >= 0)
+            order.push_back(i);
+    }
+    stable_sort(order.begin(), order.end(), [&jobs](size_t a, size_t b) {
+        return jobs[a].trace_size > jobs[b].trace_size;
+    });
+
+    atomic<size_t> next_job(0);
+    vector<thread> workers;
+    unsigned num_workers = min<size_t>(num_jobs, order.size());
+    unsigned decode_threads = max(1u, num_cores / max(1u, num_workers));
+    for (unsigned w = 0; w < num_workers; w++) {
+        workers.push_back(thread([&]() {
+            size_t i;
+            while ((i = next_job++) < order.size())
+                run_job(predictor, decode_threads, &jobs[order[i]]);
+        }));
+    }
+    for (size_t w = 0; w < workers.size(); w++)
+        workers[w].join();
+
+    // the report, in the layout of BASELINE
+    int exit_status = EXIT_SUCCESS;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const suite_job_c& job = jobs[i];
+        if ((configs.size() > 1) && ((i % traces.size()) == 0))
+            printf("==== %s\n\n", job.config.empty() ? "(no arguments)" : job.config.c_str());
+        printf("%s\n", job.trace.c_str());
+        if (!job.ran) {
+            printf("missing: %s.bz2\n", job.trace_path.c_str());
+            exit_status = EXIT_FAILURE;
+        } else {
+            printf("%s", job.output.c_str());
+            if (job.status != 0) {
+                printf("predictor exited with status %d\n", job.status);
+                exit_status = EXIT_FAILURE;
+            }
+        }
+        printf("\n");
+    }
+
+    if (csv_name)
+        write_csv(csv_name, jobs);
+    if (json_name)
+        write_json(json_name, jobs);
+    return exit_status;
+}
@@ -0,0 +1,391 @@
+/* Description: Sweeps the predictor's design space.  A grid of parameter values
+ * (see predictor_params.h) is expanded into its points, and every point is run
+ * on every trace.  The (point, trace) jobs run in this process on a pool of
+ * threads that steal work from each other, and the mispredict rate, state size
+ * and predictor time per branch are recorded for each job.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "predictor_params.h"
+#include "predictor_registry.h"
+#include "tread.h"
+
+// one parameter of the grid and the values it takes
+class sweep_axis_c
+{
+public:
+    std::string name;
+    std::vector<std::string> values;
+};
+
+// one run of one point of the grid on one trace
+class sweep_job_c
+{
+public:
+    sweep_job_c() : point(0), trace_size(0), mis_preds(0), insts(0), branches(0), state_bits(0), predictor_seconds(0) {}
+    size_t point;
+    std::string trace;
+    long long trace_size;              // used to run the longest jobs first
+    uint mis_preds;
+    uint insts;
+    uint branches;
+    uint64_t state_bits;
+    double predictor_seconds;          // time spent in get_prediction and update_predictor
+    double mpki() const { return insts ? mis_preds / (insts / 1000.0) : 0; }
+    double ns_per_branch() const { return branches ? predictor_seconds * 1e9 / branches : 0; }
+};
+
+// Each worker has a deque of jobs.  It takes jobs from the front of its own, and when that's
+// empty, steals from the back of the others'.  The jobs are dealt out longest first, so a worker
+// runs its long jobs first and what's left to steal at the end is short.
+class sweep_scheduler_c
+{
+private:
+    class worker_queue_c
+    {
+    public:
+        std::mutex mutex;
+        std::deque<size_t> jobs;
+    };
+    std::vector<worker_queue_c> queues;
+public:
+    sweep_scheduler_c(size_t num_workers) : queues(num_workers) {}
+    void deal(const std::vector<size_t> &jobs){
+        for(size_t i = 0; i < jobs.size(); i++){
+            queues[i % queues.size()].jobs.push_back(jobs[i]);
+        }
+    }
+    // the next job for 'worker'; false once every queue is empty
+    bool next(size_t worker, size_t *job){
+        {
+            std::lock_guard<std::mutex> lock(queues[worker].mutex);
+            if(!queues[worker].jobs.empty()){
+                *job = queues[worker].jobs.front();
+                queues[worker].jobs.pop_front();
+                return true;
+            }
+        }
+        for(size_t i = 1; i < queues.size(); i++){
+            worker_queue_c &victim = queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if(!victim.jobs.empty()){
+                *job = victim.jobs.back();
+                victim.jobs.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+template <class P>
+static void
+run_job(const predictor_params_c &params, sweep_job_c *job)
+{
+    // the neural net draws its initial weights from its own generator, seeded from the parameters,
+    // so a job gets the same predictor as a run of 'predictor' with the same parameters
+    P *predictor = new P(params);
+    job->state_bits = predictor->state_bits();
+
+    cbp_reader_config_c config;
+    config.decode_threads    = 1;
+    config.maintain_op_state = P::USES_OP_STATE;
+    config.print_statistics  = false;
+    std::vector<char> trace_name(job->trace.begin(), job->trace.end());
+    trace_name.push_back('\0');
+    cbp_trace_reader_c cbptr(&trace_name[0], config);
+    branch_record_c br;
+    std::chrono::steady_clock::duration predictor_time(0);
+    while(cbptr.get_branch_record(&br)){
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bool predicted_taken = predictor->get_prediction(&br, cbptr.osptr);
+        std::chrono::steady_clock::time_point predicted = std::chrono::steady_clock::now();
+        bool actual_taken    = cbptr.predict_branch(predicted_taken);
+        std::chrono::steady_clock::time_point updating = std::chrono::steady_clock::now();
+        predictor->update_predictor(&br, cbptr.osptr, actual_taken);
+        predictor_time += (predicted - start) + (std::chrono::steady_clock::now() - updating);
+        if(cbptr.is_branch_scored()){
+            job->branches++;
+            job->mis_preds += (br.is_conditional && predicted_taken != actual_taken);
+        }
+    }
+    job->insts             = cbptr.num_scored_insts();
+    job->predictor_seconds = std::chrono::duration<double>(predictor_time).count();
+    delete predictor;
+}
+
+static void
+usage(const char* prog)
+{
+    printf("usage: %s [options] <trace>...\n", prog);
+    printf("  --predictor=NAME     sweep the named predictor (default: %s)\n", DEFAULT_PREDICTOR);
+    printf("  --grid=FILE          read the grid from FILE: one \"name = value, value, ...\" per line\n");
+    printf("  --vary=NAME=V1,V2,.. add a parameter to the grid\n");
+    printf("  --params=FILE        read the parameters the grid doesn't vary from FILE\n");
+    printf("  --param=NAME=VALUE   set a parameter the grid doesn't vary\n");
+    printf("  --threads=N          run N jobs at once (default: one per core)\n");
+    printf("  --csv=FILE           also write every job's results as CSV\n");
+    exit(EXIT_FAILURE);
+}
+
+static std::string
+trim(const std::string& s)
+{
+    size_t begin = s.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos)
+        return "";
+    return s.substr(begin, s.find_last_not_of(" \t\r\n") - begin + 1);
+}
+
+// a CSV field, quoted, with its quotes doubled
+static std::string
+csv_string(const std::string& s)
+{
+    std::string quoted = "\"";
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '"')
+            quoted += '"';
+        quoted += s[i];
+    }
+    return quoted + "\"";
+}
+
+// parses "name=value,value,..." (or with spaces around the separators) into an axis
+static bool
+parse_axis(const std::string& text, sweep_axis_c* axis)
+{
+    size_t equals = text.find('=');
+    if (equals == std::string::npos)
+        return false;
+    axis->name = trim(text.substr(0, equals));
+    std::string values = text.substr(equals + 1);
+    size_t begin = 0;
+    while (begin <= values.size()) {
+        size_t end = values.find(',', begin);
+        if (end == std::string::npos)
+            end = values.size();
+        std::string value = trim(values.substr(begin, end - begin));
+        if (value.empty())
+            return false;
+        axis->values.push_back(value);
+        begin = end + 1;
+    }
+    predictor_params_c test;
+    return !axis->name.empty() && test.set(axis->name.c_str(), axis->values[0].c_str());
+}
+
+static void
+load_grid(const char* path, std::vector<sweep_axis_c>* grid)
+{
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        printf("cannot open grid file %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    char buffer[1024];
+    int line_num = 0;
+    while (fgets(buffer, sizeof(buffer), file)) {
+        line_num++;
+        std::string line(buffer);
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty())
+            continue;
+        sweep_axis_c axis;
+        if (!parse_axis(line, &axis)) {
+            printf("%s:%d: bad grid line: %s\n", path, line_num, line.c_str());
+            exit(EXIT_FAILURE);
+        }
+        grid->push_back(axis);
+    }
+    fclose(file);
+}
+
+// usage: cbpsweep [options] <trace>...
+int
+main(int argc, char* argv[])
+{
+    using namespace std;
+
+    predictor_params_c base;
+    vector<const char*> param_settings;
+    vector<sweep_axis_c> grid;
+    vector<string> traces;
+    unsigned num_threads = thread::hardware_concurrency();
+    const char* csv_name = 0;
+    const char* predictor_name = DEFAULT_PREDICTOR;
+    for (int i = 1; i < argc; i++) {
+        if (0 == strncmp(argv[i], "--predictor=", 12)) {
+            predictor_name = argv[i] + 12;
+        } else if (0 == strncmp(argv[i], "--grid=", 7)) {
+            load_grid(argv[i] + 7, &grid);
+        } else if (0 == strncmp(argv[i], "--vary=", 7)) {
+            sweep_axis_c axis;
+            if (!parse_axis(argv[i] + 7, &axis)) {
+                printf("bad grid parameter: %s\n", argv[i] + 7);
+                usage(argv[0]);
+            }
+            grid.push_back(axis);
+        } else if (0 == strncmp(argv[i], "--params=", 9)) {
+            if (!base.load(argv[i] + 9))
+                exit(EXIT_FAILURE);
+        } else if (0 == strncmp(argv[i], "--param=", 8)) {
+            param_settings.push_back(argv[i] + 8);
+        } else if (0 == strncmp(argv[i], "--threads=", 10)) {
+            num_threads = atoi(argv[i] + 10);
+        } else if (0 == strncmp(argv[i], "--csv=", 6)) {
+            csv_name = argv[i] + 6;
+        } else if ('-' != argv[i][0]) {
+            traces.push_back(argv[i]);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    for (size_t i = 0; i < param_settings.size(); i++) {
+        if (!base.set(param_settings[i])) {
+            printf("bad predictor parameter: %s\n", param_settings[i]);
+            usage(argv[0]);
+        }
+    }
+    if (traces.empty())
+        usage(argv[0]);
+    if (!find_predictor_engine(predictor_name)) {
+        printf("unknown predictor: %s\n", predictor_name);
+        usage(argv[0]);
+    }
+    if (num_threads == 0)
+        num_threads = 1;
+
+    // the points of the grid, with the first parameter varying slowest
+    vector<predictor_params_c> points(1, base);
+    for (size_t a = 0; a < grid.size(); a++) {
+        vector<predictor_params_c> expanded;
+        for (size_t p = 0; p < points.size(); p++) {
+            for (size_t v = 0; v < grid[a].values.size(); v++) {
+                predictor_params_c point = points[p];
+                if (!point.set(grid[a].name.c_str(), grid[a].values[v].c_str())) {
+                    printf("bad value for %s: %s\n", grid[a].name.c_str(), grid[a].values[v].c_str());
+                    exit(EXIT_FAILURE);
+                }
+                expanded.push_back(point);
+            }
+        }
+        points.swap(expanded);
+    }
+    // the parameters the grid and --param set, which the predictor has to take
+    unsigned settings = 0;
+    for (size_t i = 0; i < param_settings.size(); i++)
+        settings |= predictor_params_c::param_bit(param_settings[i]);
+    for (size_t a = 0; a < grid.size(); a++)
+        settings |= predictor_params_c::param_bit(grid[a].name.c_str());
+    for (size_t p = 0; p < points.size(); p++) {
+        if (!points[p].check()) {
+            printf("in point %d: %s\n", int(p), points[p].to_string().c_str());
+            exit(EXIT_FAILURE);
+        }
+        unsigned taken = 0;
+        predictor_params_c point = points[p];
+        if (!dispatch_predictor(predictor_name, point, [&](auto* engine) {
+                typedef typename std::remove_pointer<decltype(engine)>::type P;
+                taken = P::PARAMS;
+                points[p] = P::with_geometry(point);
+            })) {
+            printf("the %s predictor isn't built for the geometry of point %d; add it to predictor_matrix.h: %s\n",
+                   predictor_name, int(p), points[p].to_string().c_str());
+            exit(EXIT_FAILURE);
+        }
+        if (settings & ~taken) {
+            point.reported = settings & ~taken;
+            printf("the %s predictor doesn't take these parameters: %s\n", predictor_name,
+                   point.to_string().c_str());
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    vector<sweep_job_c> jobs;
+    for (size_t p = 0; p < points.size(); p++) {
+        for (size_t t = 0; t < traces.size(); t++) {
+            sweep_job_c job;
+            job.point = p;
+            job.trace = traces[t];
+            struct stat st;
+            if (stat(traces[t].c_str(), &st) == 0 || stat((traces[t] + ".bz2").c_str(), &st) == 0)
+                job.trace_size = st.st_size;
+            jobs.push_back(job);
+        }
+    }
+    vector<size_t> order;
+    for (size_t i = 0; i < jobs.size(); i++)
+        order.push_back(i);
+    stable_sort(order.begin(), order.end(), [&jobs](size_t a, size_t b) {
+        return jobs[a].trace_size > jobs[b].trace_size;
+    });
+
+    size_t num_workers = min<size_t>(num_threads, jobs.size());
+    sweep_scheduler_c scheduler(num_workers);
+    scheduler.deal(order);
+    vector<thread> workers;
+    for (size_t w = 0; w < num_workers; w++) {
+        workers.push_back(thread([&, w]() {
+            size_t job;
+            while (scheduler.next(w, &job)) {
+                const predictor_params_c& params = points[jobs[job].point];
+                dispatch_predictor(predictor_name, params, [&](auto* engine) {
+                    typedef typename std::remove_pointer<decltype(engine)>::type P;
+                    run_job<P>(params, &jobs[job]);
+                });
+            }
+        }));
+    }
+    for (size_t w = 0; w < workers.size(); w++)
+        workers[w].join();
+
+    // one line per point: the mean of its traces' mispredict rates, its state, and the mean
+    // predictor time per branch over all its branches
+    printf("predictor: %s\n", predictor_name);
+    printf("point   mean mpki  state KB  ns/branch  parameters\n");
+    for (size_t p = 0; p < points.size(); p++) {
+        double mpki = 0;
+        double seconds = 0;
+        uint64_t branches = 0;
+        uint64_t state_bits = 0;
+        for (size_t i = 0; i < jobs.size(); i++) {
+            if (jobs[i].point != p)
+                continue;
+            mpki       += jobs[i].mpki();
+            seconds    += jobs[i].predictor_seconds;
+            branches   += jobs[i].branches;
+            state_bits  = jobs[i].state_bits;
+        }
+        printf("%5d  %10.3f  %8.2f  %9.1f  %s\n", int(p), mpki / traces.size(), state_bits / 8192.0,
+               branches ? seconds * 1e9 / branches : 0, points[p].to_string().c_str());
+    }
+
+    if (csv_name) {
+        FILE* file = fopen(csv_name, "w");
+        if (!file) {
+            printf("cannot create %s\n", csv_name);
+            exit(EXIT_FAILURE);
+        }
+        fprintf(file, "predictor,point,params,trace,mispredicts,insts,mpki,branches,state_bits,ns_per_branch\n");
+        for (size_t i = 0; i < jobs.size(); i++) {
+            const sweep_job_c& job = jobs[i];
+            fprintf(file, "%s,%d,%s,%s,%u,%u,%.3f,%u,%llu,%.1f\n", predictor_name, int(job.point),
+                    csv_string(points[job.point].to_string()).c_str(), csv_string(job.trace).c_str(),
+                    job.mis_preds, job.insts,
+                    job.mpki(), job.branches, (unsigned long long)job.state_bits, job.ns_per_branch());
+        }
+        fclose(file);
+    }
+    return 0;
+}
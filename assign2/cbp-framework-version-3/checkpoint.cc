@@ -0,0 +1,128 @@
+/* Description: This file defines the checkpoint files that hold the warm state
+ * of a predictor; see checkpoint.h.
+*/
+
+#include "checkpoint.h"
+#include <cstring>
+
+using namespace std;
+
+static const char CHECKPOINT_MAGIC[8] = { 'C', 'B', 'P', 'C', 'K', 'P', 'T', '\n' };
+static const uint32_t CHECKPOINT_VERSION = 1;
+
+checkpoint_writer_c::checkpoint_writer_c(){
+    file   = 0;
+    failed = false;
+}
+checkpoint_writer_c::~checkpoint_writer_c(){
+    if(file){
+        fclose(file);
+    }
+}
+
+bool checkpoint_writer_c::open(const char *path_arg, const char *predictor_name, const predictor_params_c &params){
+    path = path_arg;
+    file = fopen(path_arg, "wb");
+    if(!file){
+        printf("cannot create checkpoint %s\n", path_arg);
+        return false;
+    }
+    string params_string = params.to_string();
+    write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    write_value(CHECKPOINT_VERSION);
+    write_value(uint32_t(strlen(predictor_name)));
+    write(predictor_name, strlen(predictor_name));
+    write_value(uint32_t(params_string.size()));
+    write(params_string.data(), params_string.size());
+    return true;
+}
+
+void checkpoint_writer_c::write(const void *data, size_t size){
+    if(!failed && size && fwrite(data, 1, size, file) != size){
+        failed = true;
+    }
+}
+
+bool checkpoint_writer_c::close(){
+    if(fclose(file) != 0){
+        failed = true;
+    }
+    file = 0;
+    if(failed){
+        printf("cannot write checkpoint %s\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+checkpoint_reader_c::checkpoint_reader_c(){
+    file   = 0;
+    failed = false;
+}
+checkpoint_reader_c::~checkpoint_reader_c(){
+    if(file){
+        fclose(file);
+    }
+}
+
+// reads a string written as its length and then its characters
+static bool read_string(checkpoint_reader_c *reader, string *s){
+    uint32_t size;
+    if(!reader->read_value(&size) || size > 4096){
+        return false;
+    }
+    s->resize(size);
+    return reader->read(&(*s)[0], size);
+}
+
+bool checkpoint_reader_c::open(const char *path_arg, const char *predictor_name){
+    path = path_arg;
+    file = fopen(path_arg, "rb");
+    if(!file){
+        printf("cannot open checkpoint %s\n", path_arg);
+        return false;
+    }
+    char magic[sizeof(CHECKPOINT_MAGIC)];
+    uint32_t version;
+    string saved_name;
+    if(!read(magic, sizeof(magic)) || memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0 ||
+       !read_value(&version) || version != CHECKPOINT_VERSION ||
+       !read_string(this, &saved_name) || !read_string(this, &saved_params)){
+        printf("%s is not a predictor checkpoint\n", path_arg);
+        failed = true;
+        return false;
+    }
+    if(saved_name != predictor_name){
+        printf("checkpoint %s is of the %s predictor, not %s\n", path_arg, saved_name.c_str(), predictor_name);
+        failed = true;
+        return false;
+    }
+    return true;
+}
+
+bool checkpoint_reader_c::read(void *data, size_t size){
+    if(!failed && size && fread(data, 1, size, file) != size){
+        printf("checkpoint %s is truncated\n", path.c_str());
+        failed = true;
+    }
+    return !failed;
+}
+
+bool checkpoint_reader_c::mismatch(const char *what){
+    if(!failed){
+        printf("checkpoint %s doesn't fit this predictor: the %s differs\n", path.c_str(), what);
+        printf("  the checkpoint was saved with %s\n", saved_params.c_str());
+        failed = true;
+    }
+    return false;
+}
+
+bool checkpoint_reader_c::close(){
+    if(!failed && fgetc(file) != EOF){
+        printf("checkpoint %s has data left over; it doesn't fit this predictor\n", path.c_str());
+        failed = true;
+    }
+    fclose(file);
+    file = 0;
+    return !failed;
+}
@@ -0,0 +1,127 @@
+/* Description: This file defines the checkpoint files that hold the warm state
+ * of a predictor (its tables, histories, thresholds and neural net weights), so
+ * a run can save the predictor once it has warmed up and later runs can start
+ * from there instead of replaying the warmup.
+*/
+
+#ifndef CHECKPOINT_H_SEEN
+#define CHECKPOINT_H_SEEN
+
+#include <cstdio>
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include "predictor_params.h"
+
+// A checkpoint starts with a header naming the predictor and the parameters it was built with,
+// followed by whatever the predictor's save_state writes.  The values are written in the host's
+// byte order, so a checkpoint is only good on the kind of machine that wrote it.  Each predictor's
+// load_state checks that the sizes it reads back match its own, so loading into a predictor
+// built with a different geometry fails rather than mixing up the tables.
+class checkpoint_writer_c
+{
+private:
+    // not implemented
+    checkpoint_writer_c(const checkpoint_writer_c&);
+    checkpoint_writer_c& operator=(const checkpoint_writer_c&);
+
+    FILE *file;
+    std::string path;
+    bool failed;
+public:
+    checkpoint_writer_c();
+    ~checkpoint_writer_c();
+    // creates the file and writes the header; prints a message and returns false if it can't
+    bool open(const char *path, const char *predictor_name, const predictor_params_c &params);
+    void write(const void *data, size_t size);
+    template <class T>
+    void write_value(const T &value){
+        write(&value, sizeof(value));
+    }
+    // the length, then the elements
+    template <class T>
+    void write_vector(const std::vector<T> &values){
+        write_value(uint64_t(values.size()));
+        write(values.data(), values.size() * sizeof(T));
+    }
+    // finishes the file; prints a message and returns false if anything failed to be written
+    bool close();
+};
+
+class checkpoint_reader_c
+{
+private:
+    // not implemented
+    checkpoint_reader_c(const checkpoint_reader_c&);
+    checkpoint_reader_c& operator=(const checkpoint_reader_c&);
+
+    FILE *file;
+    std::string path;
+    bool failed;
+public:
+    checkpoint_reader_c();
+    ~checkpoint_reader_c();
+    std::string saved_params;       // the parameters the checkpoint's predictor was built with, from to_string()
+
+    // opens the file and checks that it's a checkpoint of the named predictor; prints a message
+    // and returns false if it isn't
+    bool open(const char *path, const char *predictor_name);
+    // false at the end of the file, or after any earlier failure
+    bool read(void *data, size_t size);
+    template <class T>
+    bool read_value(T *value){
+        return read(value, sizeof(*value));
+    }
+    // reads a vector written by write_vector, which must hold values->size() elements
+    template <class T>
+    bool read_vector(std::vector<T> *values){
+        uint64_t size;
+        if(!read_value(&size)){
+            return false;
+        }
+        if(size != values->size()){
+            return mismatch("table size");
+        }
+        return read(values->data(), values->size() * sizeof(T));
+    }
+    // for load_state: reads a value that must equal 'expected', such as a table size
+    template <class T>
+    bool expect(const T &expected, const char *what){
+        T value;
+        if(!read_value(&value)){
+            return false;
+        }
+        return value == expected || mismatch(what);
+    }
+    // prints that the checkpoint doesn't fit the predictor being loaded and returns false
+    bool mismatch(const char *what);
+    // checks that the whole file was read; prints a message and returns false if it wasn't
+    bool close();
+};
+
+// saves a predictor (any class with save_state) to path; prints a message and returns false
+// if it can't
+template <class P>
+bool save_checkpoint(const P &predictor, const char *path, const char *predictor_name)
+{
+    checkpoint_writer_c writer;
+    if(!writer.open(path, predictor_name, predictor.get_params())){
+        return false;
+    }
+    predictor.save_state(&writer);
+    return writer.close();
+}
+
+// loads a predictor's state from path; prints a message and returns false if it can't, in which
+// case the predictor is left partly loaded
+template <class P>
+bool load_checkpoint(P *predictor, const char *path, const char *predictor_name)
+{
+    checkpoint_reader_c reader;
+    if(!reader.open(path, predictor_name)){
+        return false;
+    }
+    return predictor->load_state(&reader) && reader.close();
+}
+
+#endif // CHECKPOINT_H_SEEN
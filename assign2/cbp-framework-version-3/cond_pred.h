@@ -27,8 +27,11 @@ namespace cbp
         static std::size_t get_index(uint64_t vip, uint32_t history);
 
       public:
-        COND_PRED(void) : history(0) { std::fill_n(table, SIZE, /* weakly taken */ uint8_t(2)); }
+        COND_PRED(void) { reset(); }
         // uses compiler generated destructor
+
+        // returns the predictor to its initial state
+        void reset(void) { history = 0; std::fill_n(table, SIZE, /* weakly taken */ uint8_t(2)); }
     
         bool get_prediction(uint64_t vip) const;
         void train(uint64_t vip, bool taken);
@@ -0,0 +1,160 @@
+/* Description: This file defines predictor_fanout_c, which feeds every branch
+ * of a single pass over a trace to several predictors; see fanout.h.
+*/
+
+#include "fanout.h"
+#include <cstdio>
+
+using namespace std;
+
+template <class P>
+predictor_fanout_c<P>::predictor_fanout_c(P *first_arg, const char *first_name,
+                                          const std::vector<predictor_instance_c> &others, uint num_threads){
+    first           = first_arg;
+    predicted_taken = false;
+    generation      = 0;
+    workers_done    = 0;
+    stopping        = false;
+    instances.push_back(predictor_instance_c(first, first_name));
+    instances.insert(instances.end(), others.begin(), others.end());
+    if(num_threads > others.size()){
+        num_threads = others.size();
+    }
+    if(num_threads != 0){
+        batches[0].reserve(BATCH_SIZE);
+        batches[1].reserve(BATCH_SIZE);
+        for(uint t = 0; t < num_threads; t++){
+            workers.push_back(std::thread(&predictor_fanout_c<P>::worker, this, t));
+        }
+    }
+}
+template <class P>
+predictor_fanout_c<P>::~predictor_fanout_c(){
+    if(!workers.empty()){
+        wait_for_workers();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        batch_ready.notify_all();
+        for(size_t t = 0; t < workers.size(); t++){
+            workers[t].join();
+        }
+    }
+    for(size_t i = 1; i < instances.size(); i++){
+        delete instances[i].predictor;
+    }
+}
+
+template <class P>
+bool predictor_fanout_c<P>::load_checkpoint(const char *path){
+    for(size_t i = 1; i < instances.size(); i++){
+        if(!::load_checkpoint(instances[i].predictor, path, instances[i].name)){
+            return false;
+        }
+    }
+    return true;
+}
+
+template <class P>
+void predictor_fanout_c<P>::update_predictor(const branch_record_c *br, const op_state_c *os, bool taken, bool scored){
+    predictor_instance_c &instance = instances[0];
+    if(scored && br->is_conditional){
+        instance.num_predicts++;
+        instance.num_correct_predicts += (predicted_taken == taken);
+    }
+    first->update_predictor(br, os, taken);
+    if(workers.empty()){
+        for(size_t i = 1; i < instances.size(); i++){
+            instances[i].run(br, os, taken, scored);
+        }
+        return;
+    }
+    std::vector<batch_entry_c> &batch = batches[generation & 1];
+    batch.push_back(batch_entry_c());
+    batch.back().br     = *br;
+    batch.back().taken  = taken;
+    batch.back().scored = scored;
+    if(batch.size() == BATCH_SIZE){
+        start_batch();
+    }
+}
+
+// hands the batch being filled to the workers, once they're done with the previous one
+template <class P>
+void predictor_fanout_c<P>::start_batch(){
+    wait_for_workers();
+    std::lock_guard<std::mutex> lock(mutex);
+    generation++;
+    workers_done = 0;
+    batches[generation & 1].clear();
+    batch_ready.notify_all();
+}
+template <class P>
+void predictor_fanout_c<P>::wait_for_workers(){
+    std::unique_lock<std::mutex> lock(mutex);
+    while(generation != 0 && workers_done != workers.size()){
+        batch_done.wait(lock);
+    }
+}
+template <class P>
+void predictor_fanout_c<P>::finish(){
+    if(workers.empty()){
+        return;
+    }
+    if(!batches[generation & 1].empty()){
+        start_batch();
+    }
+    wait_for_workers();
+}
+
+// worker t runs instances t + 1, t + 1 + num_threads, ...
+template <class P>
+void predictor_fanout_c<P>::worker(uint worker_num){
+    uint64_t seen = 0;
+    while(true){
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while(!stopping && generation == seen){
+                batch_ready.wait(lock);
+            }
+            if(stopping){
+                return;
+            }
+            seen = generation;
+        }
+        const std::vector<batch_entry_c> &batch = batches[(seen - 1) & 1];
+        for(size_t i = 1 + worker_num; i < instances.size(); i += workers.size()){
+            predictor_instance_c &instance = instances[i];
+            for(size_t b = 0; b < batch.size(); b++){
+                instance.run(&batch[b].br, 0, batch[b].taken, batch[b].scored);
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            workers_done++;
+        }
+        batch_done.notify_all();
+    }
+}
+
+template <class P>
+void predictor_fanout_c<P>::print_statistics(uint num_insts) const{
+    printf("predictor  1000*wrong_cc_predicts/total insts\n");
+    for(size_t i = 0; i < instances.size(); i++){
+        const predictor_instance_c &instance = instances[i];
+        int   mis_preds     = (instance.num_predicts - instance.num_correct_predicts);
+        float mis_pred_rate = float(mis_preds)/(float(num_insts) / 1000);
+        printf("%8d:  1000 * %8d / %8d = %7.3f  %s %s\n", int(i), mis_preds, num_insts, mis_pred_rate,
+               instance.name, instance.predictor->get_params().to_string().c_str());
+    }
+    printf("*********************************************************\n");
+}
+
+#define PREDICTOR_MATRIX_INSTANTIATE(l, c, b, p) template class predictor_fanout_c<PREDICTOR_T<l, c, b, p> >;
+PREDICTOR_MATRIX(PREDICTOR_MATRIX_INSTANTIATE)
+#undef PREDICTOR_MATRIX_INSTANTIATE
+#define GHEL_MATRIX_INSTANTIATE(l, c) template class predictor_fanout_c<GHEL_PREDICTOR_T<l, c> >;
+GHEL_MATRIX(GHEL_MATRIX_INSTANTIATE)
+#undef GHEL_MATRIX_INSTANTIATE
+template class predictor_fanout_c<GSHARE_PREDICTOR>;
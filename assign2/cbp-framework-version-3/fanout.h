@@ -0,0 +1,112 @@
+/* Description: This file defines predictor_fanout_c, which feeds every branch
+ * of a single pass over a trace to several predictors, each with its own
+ * engine and parameters, so the trace is decoded once no matter how many
+ * predictors are being compared.
+*/
+
+#ifndef FANOUT_H_SEEN
+#define FANOUT_H_SEEN
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "predictor_registry.h"
+#include "tread.h"
+
+// one predictor of a fan-out run, with its own statistics
+class predictor_instance_c
+{
+public:
+    predictor_instance_c(predictor_base_c *predictor_arg, const char *name_arg)
+        : predictor(predictor_arg), name(name_arg), num_predicts(0), num_correct_predicts(0) {}
+    predictor_base_c *predictor;
+    const char *name;                               // as for --predictor=NAME
+    uint num_predicts;                              // scored conditional branches
+    uint num_correct_predicts;
+
+    // predicts and trains on one branch, the way the driver does for a single predictor
+    void run(const branch_record_c *br, const op_state_c *os, bool taken, bool scored){
+        bool predicted_taken = predictor->get_prediction(br, os);
+        if(scored && br->is_conditional){
+            num_predicts++;
+            num_correct_predicts += (predicted_taken == taken);
+        }
+        predictor->update_predictor(br, os, taken);
+    }
+};
+
+// Instance 0 is the predictor the driver reports on, and always runs on the driver's thread, in
+// step with the trace reader.  The others either run there too, right after it, or on a pool of
+// worker threads that are handed the branches in batches.  Worker threads are given no op_state,
+// so they are only for predictors that don't use it.  P is instance 0's class, one of those in
+// predictor_registry.h, so its calls are direct; the others may be any predictors, from
+// create_predictor, and are called through predictor_base_c.
+template <class P>
+class predictor_fanout_c
+{
+private:
+    // not implemented
+    predictor_fanout_c(const predictor_fanout_c&);
+    predictor_fanout_c& operator=(const predictor_fanout_c&);
+
+    class batch_entry_c
+    {
+    public:
+        branch_record_c br;
+        bool taken;
+        bool scored;
+    };
+    enum { BATCH_SIZE = (1 << 12) };
+
+    P *first;                                       // instance 0
+    std::vector<predictor_instance_c> instances;
+    bool predicted_taken;                           // instance 0's prediction for the current branch
+
+    // worker threads: the driver fills batches[generation & 1] while the workers run
+    // batches[(generation - 1) & 1]
+    std::vector<batch_entry_c> batches[2];
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable batch_ready;            // signalled by the driver
+    std::condition_variable batch_done;             // signalled by the workers
+    uint64_t generation;                            // batches handed to the workers so far
+    uint workers_done;                              // workers finished with the latest batch
+    bool stopping;
+
+    void worker(uint worker_num);
+    void start_batch();
+    void wait_for_workers();
+public:
+    // 'first_arg' is instance 0, and 'others' the rest, which the fan-out takes ownership of.
+    // A num_threads of 0 runs all of them on the driver's thread.
+    predictor_fanout_c(P *first_arg, const char *first_name, const std::vector<predictor_instance_c> &others,
+                       uint num_threads);
+    ~predictor_fanout_c();
+    // starts instances 1 and up from a checkpoint, the way the driver starts instance 0; prints
+    // a message and returns false if it can't, as when the checkpoint is another predictor's
+    bool load_checkpoint(const char *path);
+
+    // instance 0's prediction, to pass to cbp_trace_reader_c::predict_branch
+    bool get_prediction(const branch_record_c *br, const op_state_c *os){
+        predicted_taken = first->get_prediction(br, os);
+        return predicted_taken;
+    }
+    // scores and updates instance 0, and runs the branch through the others
+    void update_predictor(const branch_record_c *br, const op_state_c *os, bool taken, bool scored);
+    // waits for the workers to catch up; call at the end of the trace
+    void finish();
+    // prints each instance's statistics over num_insts instructions, under its name and parameters
+    void print_statistics(uint num_insts) const;
+};
+
+#define PREDICTOR_MATRIX_EXTERN(l, c, b, p) extern template class predictor_fanout_c<PREDICTOR_T<l, c, b, p> >;
+PREDICTOR_MATRIX(PREDICTOR_MATRIX_EXTERN)
+#undef PREDICTOR_MATRIX_EXTERN
+#define GHEL_MATRIX_EXTERN(l, c) extern template class predictor_fanout_c<GHEL_PREDICTOR_T<l, c> >;
+GHEL_MATRIX(GHEL_MATRIX_EXTERN)
+#undef GHEL_MATRIX_EXTERN
+extern template class predictor_fanout_c<GSHARE_PREDICTOR>;
+
+#endif // FANOUT_H_SEEN
@@ -23,9 +23,12 @@ namespace cbp
         uint64_t stack[MAX_SIZE];
 
       public:
-        FINITE_STACK(void) : top_ptr(0) { std::fill_n(stack, MAX_SIZE, 0); }
+        FINITE_STACK(void) { reset(); }
         // uses compiler generated destructor
 
+        // empties the stack
+        void reset(void) { top_ptr = 0; std::fill_n(stack, MAX_SIZE, 0); }
+
         void push(uint64_t value);
         uint64_t top(void) const { return stack[top_ptr]; }
         void pop(void) { top_ptr = ((top_ptr - 1) % MAX_SIZE); } 
@@ -28,47 +28,80 @@
 #include <assert.h>
 #include <errno.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
-#ifndef genann_act
+/* The activation is picked at compile time, so the calls to it can be inlined: genann_act if
+ * it's defined, and otherwise genann_act_sigmoid_cached, which is what genann_init sets
+ * activation_hidden and activation_output to.  The cached sigmoid then runs on a whole layer
+ * at once in the SIMD kernels.  Building with -DGENANN_RUNTIME_ACTIVATION calls
+ * ann->activation_hidden and ann->activation_output through their pointers instead. */
+#ifdef GENANN_RUNTIME_ACTIVATION
 #define genann_act_hidden genann_act_hidden_indirect
 #define genann_act_output genann_act_output_indirect
+#define genann_output_is_linear(ann) ((ann)->activation_output == genann_act_linear)
 #else
+#ifndef genann_act
+#define genann_act genann_act_sigmoid_cached
+#define GENANN_ACT_SIGMOID_CACHED
+#endif
 #define genann_act_hidden genann_act
 #define genann_act_output genann_act
+#define genann_output_is_linear(ann) (genann_act_output == genann_act_linear)
 #endif
 
 #define LOOKUP_SIZE 4096
 
-double randn (double mu, double sigma)
+/* Each network's random numbers come from its own additive feedback generator, the one glibc's
+ * rand() uses: x[i] = x[i-31] + x[i-3], returning the top 31 bits, with the 31 words seeded by
+ * a Park-Miller generator and the first 310 results thrown away.  A network seeded with 1 gets
+ * the weights genann_init used to draw from rand() in a fresh process, and networks on different
+ * threads don't share any state. */
+void genann_seed(genann *ann, uint32_t seed) {
+    int32_t word = seed ? (int32_t)seed : 1;
+    int i;
+    ann->random_state[0] = (uint32_t)word;
+    for (i = 1; i < GENANN_RANDOM_WORDS; ++i) {
+        const int32_t hi = word / 127773, lo = word % 127773;
+        word = 16807 * lo - 2836 * hi;
+        if (word < 0) word += 2147483647;
+        ann->random_state[i] = (uint32_t)word;
+    }
+    ann->random_front = 3;
+    ann->random_rear = 0;
+    for (i = 0; i < 10 * GENANN_RANDOM_WORDS; ++i) {
+        genann_random(ann);
+    }
+}
+
+uint32_t genann_random(genann *ann) {
+    uint32_t *x = ann->random_state;
+    const uint32_t r = x[ann->random_front] += x[ann->random_rear];
+    if (++ann->random_front == GENANN_RANDOM_WORDS) ann->random_front = 0;
+    if (++ann->random_rear == GENANN_RANDOM_WORDS) ann->random_rear = 0;
+    return r >> 1;
+}
+
+double randn (genann *ann, double mu, double sigma)
 {
   double U1, U2, W, mult;
-  static double X1, X2;
-  static int call = 0;
- 
-  if (call == 1)
-    {
-      call = !call;
-      return (mu + sigma * (double) X2);
-    }
  
   do
     {
-      U1 = -1 + ((double) rand () / RAND_MAX) * 2;
-      U2 = -1 + ((double) rand () / RAND_MAX) * 2;
+      U1 = -1 + GENANN_RANDOM(ann) * 2;
+      U2 = -1 + GENANN_RANDOM(ann) * 2;
       W = pow (U1, 2) + pow (U2, 2);
     }
   while (W >= 1 || W == 0);
  
   mult = sqrt ((-2 * log (W)) / W);
-  X1 = U1 * mult;
-  X2 = U2 * mult;
  
-  call = !call;
- 
-  return (mu + sigma * (double) X1);
+  return (mu + sigma * (double) (U1 * mult));
 }
 
 double genann_act_hidden_indirect(const struct genann *ann, double a) {
@@ -79,10 +112,13 @@ double genann_act_output_indirect(const struct genann *ann, double a) {
     return ann->activation_output(ann, a);
 }
 
+/* The lookup table is shared by every network; it's filled once, before the first network is
+ * created, and only read after that. */
 const double sigmoid_dom_min = -15.0;
 const double sigmoid_dom_max = 15.0;
-double interval;
-double lookup[LOOKUP_SIZE];
+static const double interval = LOOKUP_SIZE / (15.0 - -15.0);
+static double lookup[LOOKUP_SIZE];
+static pthread_once_t lookup_once = PTHREAD_ONCE_INIT;
 
 #define likely(x)       __builtin_expect(!!(x), 1)
 #define unlikely(x)     __builtin_expect(!!(x), 0)
@@ -94,16 +130,19 @@ double inline genann_act_sigmoid(const genann *ann __unused, double a) {
     return 1.0 / (1 + exp(-a));
 }
 
-void genann_init_sigmoid_lookup(const genann *ann) {
+static void genann_fill_sigmoid_lookup(void) {
         const double f = (sigmoid_dom_max - sigmoid_dom_min) / LOOKUP_SIZE;
         int i;
 
-        interval = LOOKUP_SIZE / (sigmoid_dom_max - sigmoid_dom_min);
         for (i = 0; i < LOOKUP_SIZE; ++i) {
-            lookup[i] = genann_act_sigmoid(ann, sigmoid_dom_min + f * i);
+            lookup[i] = genann_act_sigmoid(0, sigmoid_dom_min + f * i);
         }
 }
 
+void genann_init_sigmoid_lookup(const genann *ann __unused) {
+        pthread_once(&lookup_once, genann_fill_sigmoid_lookup);
+}
+
 double inline genann_act_sigmoid_cached(const genann *ann __unused, double a) {
     assert(!isnan(a));
 
@@ -127,7 +166,349 @@ double inline genann_act_threshold(const struct genann *ann __unused, double a)
     return a > 0;
 }
 
+/* The weights of each layer are stored by input, the bias first: an input's weights to each of
+ * the layer's neurons form a row, padded with zeros to a multiple of GENANN_LANES doubles, and
+ * the buffer is 64-byte aligned, so every row is too.  The kernels below work on a row at a time
+ * across the neurons, so each neuron's sum is still formed one input after another, in the same
+ * order as genann's original neuron-by-neuron loops, and comes out exactly the same whichever
+ * kernel runs. */
+#define GENANN_LANES 8
+#define GENANN_ALIGN 64
+
+static int genann_pad(int n) {
+    return (n + GENANN_LANES - 1) / GENANN_LANES * GENANN_LANES;
+}
+
+/* Layer l is hidden layer l, or the output layer if l == hidden_layers. */
+static int layer_inputs(genann const *ann, int l) {
+    return l == 0 ? ann->inputs : ann->hidden;
+}
+
+static int layer_neurons(genann const *ann, int l) {
+    return l == ann->hidden_layers ? ann->outputs : ann->hidden;
+}
+
+static int layer_stride(genann const *ann, int l) {
+    return genann_pad(layer_neurons(ann, l));
+}
+
+static double *layer_weights(genann const *ann, int l) {
+    if (l == 0) return ann->weight;
+    const int stride = genann_pad(ann->hidden);
+    return ann->weight + (ann->inputs+1) * stride + (l-1) * (ann->hidden+1) * stride;
+}
+
+static double *layer_input_values(genann const *ann, int l) {
+    return ann->output + (l == 0 ? 0 : ann->inputs + (l-1) * ann->hidden);
+}
+
+static double *layer_outputs(genann const *ann, int l) {
+    return ann->output + ann->inputs + l * ann->hidden;
+}
+
+static double *layer_deltas(genann const *ann, int l) {
+    return ann->delta + l * ann->hidden;
+}
+
+/* The position in ann->weight of weight n in genann's original order, in which each neuron's
+ * bias and input weights follow the previous neuron's. */
+static int genann_weight_position(genann const *ann, int n) {
+    int l;
+    for (l = 0; l <= ann->hidden_layers; ++l) {
+        const int row = layer_inputs(ann, l) + 1;
+        const int count = row * layer_neurons(ann, l);
+        if (n < count) {
+            return (int)(layer_weights(ann, l) - ann->weight) + (n % row) * layer_stride(ann, l) + n / row;
+        }
+        n -= count;
+    }
+    assert(0);
+    return -1;
+}
+
+
+/* The SIMD kernels, one set per instruction set; see genann_select_kernels.
+ *
+ * forward:        acc[j] = rows[j] * -1.0 + the sum over k of rows[(k+1)*stride + j] * x[k]
+ * forward_sparse: the same, for inputs that are 1 at active[] and then n_dense inputs x[]
+ *                 starting at input first_dense
+ * update:         rows[j] += d[j] * rate * -1.0, and rows[(k+1)*stride + j] += d[j] * rate * x[k]
+ * update_sparse:  the same, for the inputs of forward_sparse
+ * sigmoid_cached: a[j] = genann_act_sigmoid_cached(ann, a[j])
+ * backward:       acc[j] = the sum over k < following of d[k] * rows[(j+1)*stride + k], for j < n
+ *                 (the weighted deltas of the layer the rows feed); acc has room for n rounded up
+ *                 to the vector width.  Neuron j's row is strided across the lanes, so the vector
+ *                 versions gather it.
+ *
+ * for j < stride.  The rows are aligned; acc and d need not be.  The multiplies and adds are kept
+ * separate, as in the scalar code.  AVX-512F includes FMA, so the build turns contraction off
+ * (-ffp-contract=off in the Makefile) to keep the compiler from fusing them; "make check-kernels"
+ * checks that every set of kernels gives the same results. */
+typedef struct genann_kernels {
+    const char *name;
+    void (*forward)(double *acc, double const *rows, int stride, double const *x, int n);
+    void (*forward_sparse)(double *acc, double const *rows, int stride, int const *active, int num_active,
+                           double const *x, int first_dense, int n_dense);
+    void (*update)(double *rows, int stride, double const *d, double rate, double const *x, int n);
+    void (*update_sparse)(double *rows, int stride, double const *d, double rate, int const *active, int num_active,
+                          double const *x, int first_dense, int n_dense);
+    void (*sigmoid_cached)(double *a, int stride);
+    void (*backward)(double *acc, double const *rows, int stride, double const *d, int following, int n);
+} genann_kernels;
+
+#define GENANN_KERNELS(isa, attr, vec, width, load, loadu, storeu, add, mul, set1, sigmoid_cached, backward) \
+static attr void genann_forward_##isa(double *acc, double const *rows, int stride, double const *x, int n) { \
+    int j, k; \
+    for (j = 0; j < stride; j += width) { \
+        vec sum = mul(load(rows + j), set1(-1.0)); \
+        for (k = 0; k < n; ++k) { \
+            sum = add(sum, mul(load(rows + (k+1) * stride + j), set1(x[k]))); \
+        } \
+        storeu(acc + j, sum); \
+    } \
+} \
+static attr void genann_forward_sparse_##isa(double *acc, double const *rows, int stride, int const *active, int num_active, \
+                                             double const *x, int first_dense, int n_dense) { \
+    int j, k; \
+    for (j = 0; j < stride; j += width) { \
+        vec sum = mul(load(rows + j), set1(-1.0)); \
+        for (k = 0; k < num_active; ++k) { \
+            sum = add(sum, load(rows + (active[k]+1) * stride + j)); \
+        } \
+        for (k = 0; k < n_dense; ++k) { \
+            sum = add(sum, mul(load(rows + (first_dense+k+1) * stride + j), set1(x[k]))); \
+        } \
+        storeu(acc + j, sum); \
+    } \
+} \
+static attr void genann_update_##isa(double *rows, int stride, double const *d, double rate, double const *x, int n) { \
+    int j, k; \
+    for (j = 0; j < stride; j += width) { \
+        vec dr = mul(loadu(d + j), set1(rate)); \
+        storeu(rows + j, add(load(rows + j), mul(dr, set1(-1.0)))); \
+        for (k = 0; k < n; ++k) { \
+            double *w = rows + (k+1) * stride + j; \
+            storeu(w, add(load(w), mul(dr, set1(x[k])))); \
+        } \
+    } \
+} \
+static attr void genann_update_sparse_##isa(double *rows, int stride, double const *d, double rate, int const *active, int num_active, \
+                                            double const *x, int first_dense, int n_dense) { \
+    int j, k; \
+    for (j = 0; j < stride; j += width) { \
+        vec dr = mul(loadu(d + j), set1(rate)); \
+        storeu(rows + j, add(load(rows + j), mul(dr, set1(-1.0)))); \
+        for (k = 0; k < num_active; ++k) { \
+            double *w = rows + (active[k]+1) * stride + j; \
+            storeu(w, add(load(w), dr)); \
+        } \
+        for (k = 0; k < n_dense; ++k) { \
+            double *w = rows + (first_dense+k+1) * stride + j; \
+            storeu(w, add(load(w), mul(dr, set1(x[k])))); \
+        } \
+    } \
+} \
+static const genann_kernels genann_kernels_##isa = { \
+    #isa, genann_forward_##isa, genann_forward_sparse_##isa, genann_update_##isa, genann_update_sparse_##isa, \
+    sigmoid_cached, backward \
+};
+
+/* The cached sigmoid of a whole layer.  The vector versions compute each lookup index with the
+ * same arithmetic as genann_act_sigmoid_cached, and clamp it to the table instead of testing
+ * the range, which picks the same entries, so the results are exactly the same. */
+static void genann_sigmoid_cached_scalar(double *a, int stride) {
+    int j;
+    for (j = 0; j < stride; ++j) {
+        a[j] = genann_act_sigmoid_cached(0, a[j]);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#define GENANN_SIGMOID_INDEX(isa, a) \
+    isa##_min_pd(isa##_max_pd(isa##_add_pd(isa##_mul_pd(isa##_sub_pd(a, isa##_set1_pd(sigmoid_dom_min)), \
+                                                        isa##_set1_pd(interval)), isa##_set1_pd(0.5)), \
+                              isa##_setzero_pd()), isa##_set1_pd(LOOKUP_SIZE - 1))
+
+static __attribute__((target("sse2"))) void genann_sigmoid_cached_sse2(double *a, int stride) {
+    int j;
+    for (j = 0; j < stride; j += 2) {
+        __m128i index = _mm_cvttpd_epi32(GENANN_SIGMOID_INDEX(_mm, _mm_loadu_pd(a + j)));
+        a[j] = lookup[_mm_cvtsi128_si32(index)];
+        a[j+1] = lookup[_mm_cvtsi128_si32(_mm_srli_si128(index, 4))];
+    }
+}
+
+static __attribute__((target("avx2"))) void genann_sigmoid_cached_avx2(double *a, int stride) {
+    int j;
+    for (j = 0; j < stride; j += 4) {
+        __m128i index = _mm256_cvttpd_epi32(GENANN_SIGMOID_INDEX(_mm256, _mm256_loadu_pd(a + j)));
+        _mm256_storeu_pd(a + j, _mm256_i32gather_pd(lookup, index, 8));
+    }
+}
+
+static __attribute__((target("avx512f"))) void genann_sigmoid_cached_avx512(double *a, int stride) {
+    int j;
+    for (j = 0; j < stride; j += 8) {
+        __m256i index = _mm512_cvttpd_epi32(GENANN_SIGMOID_INDEX(_mm512, _mm512_loadu_pd(a + j)));
+        _mm512_storeu_pd(a + j, _mm512_i32gather_pd(index, lookup, 8));
+    }
+}
+#endif
+
+/* The weighted deltas.  Each neuron's sum starts at 0 and adds its terms in order of k, as the
+ * scalar code does, so the results are exactly the same; the lanes past n gather neuron n-1's
+ * row, which is in the weights, and their sums are ignored. */
+static void genann_backward_scalar(double *acc, double const *rows, int stride, double const *d, int following, int n) {
+    int j, k;
+    for (j = 0; j < n; ++j) {
+        double const *row = rows + (j+1) * stride;
+        double sum = 0;
+        for (k = 0; k < following; ++k) {
+            sum += d[k] * row[k];
+        }
+        acc[j] = sum;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static __attribute__((target("sse2"))) void genann_backward_sse2(double *acc, double const *rows, int stride, double const *d,
+                                                                 int following, int n) {
+    int j, k;
+    for (j = 0; j < n; j += 2) {
+        double const *row0 = rows + (j+1) * stride;
+        double const *row1 = rows + ((j+1 < n ? j+1 : n-1) + 1) * stride;
+        __m128d sum = _mm_setzero_pd();
+        for (k = 0; k < following; ++k) {
+            sum = _mm_add_pd(sum, _mm_mul_pd(_mm_set1_pd(d[k]), _mm_set_pd(row1[k], row0[k])));
+        }
+        _mm_storeu_pd(acc + j, sum);
+    }
+}
+
+static __attribute__((target("avx2"))) void genann_backward_avx2(double *acc, double const *rows, int stride, double const *d,
+                                                                 int following, int n) {
+    int j, k, l;
+    for (j = 0; j < n; j += 4) {
+        int first[4];
+        for (l = 0; l < 4; ++l) {
+            first[l] = ((j+l < n ? j+l : n-1) + 1) * stride;
+        }
+        __m128i index = _mm_loadu_si128((__m128i const *)first);
+        __m256d sum = _mm256_setzero_pd();
+        for (k = 0; k < following; ++k) {
+            __m256d w = _mm256_i32gather_pd(rows, _mm_add_epi32(index, _mm_set1_epi32(k)), 8);
+            sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_set1_pd(d[k]), w));
+        }
+        _mm256_storeu_pd(acc + j, sum);
+    }
+}
+
+static __attribute__((target("avx512f"))) void genann_backward_avx512(double *acc, double const *rows, int stride, double const *d,
+                                                                      int following, int n) {
+    int j, k, l;
+    for (j = 0; j < n; j += 8) {
+        int first[8];
+        for (l = 0; l < 8; ++l) {
+            first[l] = ((j+l < n ? j+l : n-1) + 1) * stride;
+        }
+        __m256i index = _mm256_loadu_si256((__m256i const *)first);
+        __m512d sum = _mm512_setzero_pd();
+        for (k = 0; k < following; ++k) {
+            __m512d w = _mm512_i32gather_pd(_mm256_add_epi32(index, _mm256_set1_epi32(k)), rows, 8);
+            sum = _mm512_add_pd(sum, _mm512_mul_pd(_mm512_set1_pd(d[k]), w));
+        }
+        _mm512_storeu_pd(acc + j, sum);
+    }
+}
+#endif
+
+#define SCALAR_LOAD(p) (*(p))
+#define SCALAR_STORE(p, v) (*(p) = (v))
+#define SCALAR_ADD(a, b) ((a) + (b))
+#define SCALAR_MUL(a, b) ((a) * (b))
+#define SCALAR_SET1(a) (a)
+GENANN_KERNELS(scalar, , double, 1, SCALAR_LOAD, SCALAR_LOAD, SCALAR_STORE, SCALAR_ADD, SCALAR_MUL, SCALAR_SET1,
+               genann_sigmoid_cached_scalar, genann_backward_scalar)
+
+#if defined(__x86_64__) || defined(__i386__)
+GENANN_KERNELS(sse2, __attribute__((target("sse2"))), __m128d, 2,
+               _mm_load_pd, _mm_loadu_pd, _mm_storeu_pd, _mm_add_pd, _mm_mul_pd, _mm_set1_pd,
+               genann_sigmoid_cached_sse2, genann_backward_sse2)
+GENANN_KERNELS(avx2, __attribute__((target("avx2"))), __m256d, 4,
+               _mm256_load_pd, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, _mm256_mul_pd, _mm256_set1_pd,
+               genann_sigmoid_cached_avx2, genann_backward_avx2)
+GENANN_KERNELS(avx512, __attribute__((target("avx512f"))), __m512d, 8,
+               _mm512_load_pd, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_add_pd, _mm512_mul_pd, _mm512_set1_pd,
+               genann_sigmoid_cached_avx512, genann_backward_avx512)
+#endif
+
+static genann_kernels const *kernels;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+/* Picks the widest kernels the CPU supports, the first time a network is created.  Setting
+ * GENANN_KERNELS to scalar, sse2, avx2 or avx512 picks those instead, if the CPU supports them. */
+static void genann_pick_kernels(void) {
+    genann_kernels const *supported[4];
+    int n = 0, i;
+    supported[n++] = &genann_kernels_scalar;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) supported[n++] = &genann_kernels_sse2;
+    if (__builtin_cpu_supports("avx2")) supported[n++] = &genann_kernels_avx2;
+    if (__builtin_cpu_supports("avx512f")) supported[n++] = &genann_kernels_avx512;
+#endif
+    genann_kernels const *chosen = supported[n-1];
+
+    const char *name = getenv("GENANN_KERNELS");
+    if (name && *name) {
+        for (i = 0; i < n && strcmp(supported[i]->name, name) != 0; ++i) {
+        }
+        if (i < n) {
+            chosen = supported[i];
+        } else {
+            fprintf(stderr, "GENANN_KERNELS=%s isn't supported here; using %s\n", name, chosen->name);
+        }
+    }
+    kernels = chosen;
+}
+
+static void genann_select_kernels(void) {
+    pthread_once(&kernels_once, genann_pick_kernels);
+}
+
+const char *genann_kernels_name(void) {
+    genann_select_kernels();
+    return kernels->name;
+}
+
+
+/* The bytes of a network: the genann, then the weights, outputs and deltas. */
+static size_t genann_size(int inputs, int hidden_layers, int hidden, int outputs, size_t *weight_offset, int *weight_size) {
+    int l, size = 0;
+    for (l = 0; l <= hidden_layers; ++l) {
+        const int n_in = l == 0 ? inputs : hidden;
+        const int n_out = l == hidden_layers ? outputs : hidden;
+        size += (n_in + 1) * genann_pad(n_out);
+    }
+    const int total_neurons = (inputs + hidden * hidden_layers + outputs);
+    *weight_offset = (sizeof(genann) + GENANN_ALIGN - 1) / GENANN_ALIGN * GENANN_ALIGN;
+    *weight_size = size;
+    size_t bytes = *weight_offset + sizeof(double) * (size + total_neurons + (total_neurons - inputs));
+    return (bytes + GENANN_ALIGN - 1) / GENANN_ALIGN * GENANN_ALIGN;
+}
+
+static void genann_set_pointers(genann *ann, size_t weight_offset) {
+    ann->weight = (double*)((char*)ann + weight_offset);
+    ann->output = ann->weight + ann->weight_size;
+    ann->delta = ann->output + ann->total_neurons;
+}
+
 genann *genann_init(int inputs, int hidden_layers, int hidden, int outputs) {
+    return genann_init_seeded(inputs, hidden_layers, hidden, outputs, GENANN_DEFAULT_SEED);
+}
+
+
+genann *genann_init_seeded(int inputs, int hidden_layers, int hidden, int outputs, uint32_t seed) {
     if (hidden_layers < 0) return 0;
     if (inputs < 1) return 0;
     if (outputs < 1) return 0;
@@ -141,9 +522,12 @@ genann *genann_init(int inputs, int hidden_layers, int hidden, int outputs) {
     const int total_neurons = (inputs + hidden * hidden_layers + outputs);
 
     /* Allocate extra size for weights, outputs, and deltas. */
-    const int size = sizeof(genann) + sizeof(double) * (total_weights + total_neurons + (total_neurons - inputs));
-    genann *ret = malloc(size);
+    size_t weight_offset;
+    int weight_size;
+    const size_t size = genann_size(inputs, hidden_layers, hidden, outputs, &weight_offset, &weight_size);
+    genann *ret = aligned_alloc(GENANN_ALIGN, size);
     if (!ret) return 0;
+    memset(ret, 0, size);
 
     ret->inputs = inputs;
     ret->hidden_layers = hidden_layers;
@@ -152,18 +536,18 @@ genann *genann_init(int inputs, int hidden_layers, int hidden, int outputs) {
 
     ret->total_weights = total_weights;
     ret->total_neurons = total_neurons;
+    ret->weight_size = weight_size;
 
-    /* Set pointers. */
-    ret->weight = (double*)((char*)ret + sizeof(genann));
-    ret->output = ret->weight + ret->total_weights;
-    ret->delta = ret->output + ret->total_neurons;
+    genann_set_pointers(ret, weight_offset);
 
+    genann_seed(ret, seed);
     genann_randomize(ret);
 
     ret->activation_hidden = genann_act_sigmoid_cached;
     ret->activation_output = genann_act_sigmoid_cached;
 
     genann_init_sigmoid_lookup(ret);
+    genann_select_kernels();
 
     return ret;
 }
@@ -185,7 +569,7 @@ genann *genann_read(FILE *in) {
     int i;
     for (i = 0; i < ann->total_weights; ++i) {
         errno = 0;
-        rc = fscanf(in, " %le", ann->weight + i);
+        rc = fscanf(in, " %le", ann->weight + genann_weight_position(ann, i));
         if (rc < 1 || errno != 0) {
             perror("fscanf");
             genann_free(ann);
@@ -199,16 +583,16 @@ genann *genann_read(FILE *in) {
 
 
 genann *genann_copy(genann const *ann) {
-    const int size = sizeof(genann) + sizeof(double) * (ann->total_weights + ann->total_neurons + (ann->total_neurons - ann->inputs));
-    genann *ret = malloc(size);
+    size_t weight_offset;
+    int weight_size;
+    const size_t size = genann_size(ann->inputs, ann->hidden_layers, ann->hidden, ann->outputs, &weight_offset, &weight_size);
+    genann *ret = aligned_alloc(GENANN_ALIGN, size);
     if (!ret) return 0;
 
     memcpy(ret, ann, size);
 
     /* Set pointers. */
-    ret->weight = (double*)((char*)ret + sizeof(genann));
-    ret->output = ret->weight + ret->total_weights;
-    ret->delta = ret->output + ret->total_neurons;
+    genann_set_pointers(ret, weight_offset);
 
     return ret;
 }
@@ -217,105 +601,132 @@ genann *genann_copy(genann const *ann) {
 void genann_randomize(genann *ann) {
     int i;
     for (i = 0; i < ann->total_weights; ++i) {
-        double r = GENANN_RANDOM();
-		//double r = randn(0, 1);
+        double r = GENANN_RANDOM(ann);
+		//double r = randn(ann, 0, 1);
         /* Sets weights from -0.5 to 0.5. */
-        ann->weight[i] = r - 0.5;
+        ann->weight[genann_weight_position(ann, i)] = r - 0.5;
     }
 }
 
 
-void genann_free(genann *ann) {
-    /* The weight, output, and delta pointers go to the same buffer. */
-    free(ann);
+void genann_get_weights(genann const *ann, double *weights) {
+    int i;
+    for (i = 0; i < ann->total_weights; ++i) {
+        weights[i] = ann->weight[genann_weight_position(ann, i)];
+    }
 }
 
 
-double const *genann_run(genann const *ann, double const *inputs) {
-    double const *w = ann->weight;
-    double *o = ann->output + ann->inputs;
-    double const *i = ann->output;
+void genann_set_weights(genann *ann, double const *weights) {
+    int i;
+    for (i = 0; i < ann->total_weights; ++i) {
+        ann->weight[genann_weight_position(ann, i)] = weights[i];
+    }
+}
 
-    /* Copy the inputs to the scratch area, where we also store each neuron's
-     * output, for consistency. This way the first layer isn't a special case. */
-    memcpy(ann->output, inputs, sizeof(double) * ann->inputs);
 
-    int h, j, k;
+void genann_free(genann *ann) {
+    /* The weight, output, and delta pointers go to the same buffer. */
+    free(ann);
+}
 
-    if (!ann->hidden_layers) {
-        double *ret = o;
-        for (j = 0; j < ann->outputs; ++j) {
-            double sum = *w++ * -1.0;
-            for (k = 0; k < ann->inputs; ++k) {
-                sum += *w++ * i[k];
-            }
-            *o++ = genann_act_output(ann, sum);
-        }
 
-        return ret;
+/* Applies the activation to the sums of layer l's neurons, which acc holds padded to the
+ * layer's stride. */
+static void genann_activate_layer(genann const *ann, int l, double *acc) {
+    double *o = layer_outputs(ann, l);
+    const int n = layer_neurons(ann, l);
+#ifdef GENANN_ACT_SIGMOID_CACHED
+    kernels->sigmoid_cached(acc, layer_stride(ann, l));
+    memcpy(o, acc, sizeof(double) * n);
+#else
+    int j;
+    if (l == ann->hidden_layers) {
+        for (j = 0; j < n; ++j) {
+            o[j] = genann_act_output(ann, acc[j]);
+        }
+    } else {
+        for (j = 0; j < n; ++j) {
+            o[j] = genann_act_hidden(ann, acc[j]);
+        }
     }
+#endif
+}
 
-    /* Figure input layer */
-    for (j = 0; j < ann->hidden; ++j) {
-        double sum = *w++ * -1.0;
-        for (k = 0; k < ann->inputs; ++k) {
-            sum += *w++ * i[k];
-        }
-        *o++ = genann_act_hidden(ann, sum);
+
+/* Figures the layers from 'first' on, whose inputs are in ann->output. */
+static double const *genann_run_from(genann const *ann, int first) {
+    int l;
+    for (l = first; l <= ann->hidden_layers; ++l) {
+        const int stride = layer_stride(ann, l);
+        double acc[stride];
+        kernels->forward(acc, layer_weights(ann, l), stride, layer_input_values(ann, l), layer_inputs(ann, l));
+        genann_activate_layer(ann, l, acc);
     }
+    return layer_outputs(ann, ann->hidden_layers);
+}
 
-    i += ann->inputs;
 
-    /* Figure hidden layers, if any. */
-    for (h = 1; h < ann->hidden_layers; ++h) {
-        for (j = 0; j < ann->hidden; ++j) {
-            double sum = *w++ * -1.0;
-            for (k = 0; k < ann->hidden; ++k) {
-                sum += *w++ * i[k];
-            }
-            *o++ = genann_act_hidden(ann, sum);
-        }
+double const *genann_run(genann const *ann, double const *inputs) {
+    /* Copy the inputs to the scratch area, where we also store each neuron's
+     * output, for consistency. This way the first layer isn't a special case. */
+    memcpy(ann->output, inputs, sizeof(double) * ann->inputs);
 
-        i += ann->hidden;
-    }
+    return genann_run_from(ann, 0);
+}
 
-    double const *ret = o;
 
-    /* Figure output layer. */
-    for (j = 0; j < ann->outputs; ++j) {
-        double sum = *w++ * -1.0;
-        for (k = 0; k < ann->hidden; ++k) {
-            sum += *w++ * i[k];
+/* Lists the inputs that are 1 among the first binary_inputs, in order; returns how many there are. */
+static int genann_active_inputs(uint64_t const *bits, int binary_inputs, int *active) {
+    int n = 0;
+    int b;
+    for (b = 0; b * 64 < binary_inputs; ++b) {
+        uint64_t word = bits[b];
+        if (binary_inputs - b * 64 < 64) {
+            word &= (UINT64_C(1) << (binary_inputs - b * 64)) - 1;
+        }
+        while (word) {
+            active[n++] = b * 64 + __builtin_ctzll(word);
+            word &= word - 1;
         }
-        *o++ = genann_act_output(ann, sum);
     }
-    //printf("ret: %lf\n", ret);
-    //fflush(stdout);
+    return n;
+}
 
-    /* Sanity check that we used all weights and wrote all outputs. */
-    assert(w - ann->weight == ann->total_weights);
-    assert(o - ann->output == ann->total_neurons);
 
-    return ret;
+/* The first layer of genann_run_sparse.  The rows of the inputs that are 0 are skipped, and
+ * those of the inputs that are 1 are added in the same order genann_run adds them, so the sums
+ * are exactly the same. */
+static void genann_run_first_sparse(genann const *ann, int const *active, int num_active, int binary_inputs, double const *dense) {
+    const int stride = layer_stride(ann, 0);
+    double acc[stride];
+    kernels->forward_sparse(acc, layer_weights(ann, 0), stride, active, num_active,
+                            dense, binary_inputs, ann->inputs - binary_inputs);
+    genann_activate_layer(ann, 0, acc);
 }
 
 
-void genann_train(genann const *ann, double const *inputs, double const *desired_outputs, double learning_rate) {
-    /* To begin with, we must run the network forward. */
-    genann_run(ann, inputs);
+double const *genann_run_sparse(genann const *ann, uint64_t const *bits, int binary_inputs, double const *dense) {
+    int active[binary_inputs > 0 ? binary_inputs : 1];
+    int num_active = genann_active_inputs(bits, binary_inputs, active);
+    genann_run_first_sparse(ann, active, num_active, binary_inputs, dense);
+    return genann_run_from(ann, 1);
+}
 
-    int h, j, k;
+
+/* Sets the deltas of every neuron after a forward run. */
+static void genann_set_deltas(genann const *ann, double const *desired_outputs) {
+    int h, j;
 
     /* First set the output layer deltas. */
     {
-        double const *o = ann->output + ann->inputs + ann->hidden * ann->hidden_layers; /* First output. */
-        double *d = ann->delta + ann->hidden * ann->hidden_layers; /* First delta. */
+        double const *o = layer_outputs(ann, ann->hidden_layers); /* First output. */
+        double *d = layer_deltas(ann, ann->hidden_layers); /* First delta. */
         double const *t = desired_outputs; /* First desired output. */
 
 
         /* Set output layer deltas. */
-        if (genann_act_output == genann_act_linear ||
-                ann->activation_output == genann_act_linear) {
+        if (genann_output_is_linear(ann)) {
             for (j = 0; j < ann->outputs; ++j) {
                 *d++ = *t++ - *o++;
             }
@@ -333,88 +744,104 @@ void genann_train(genann const *ann, double const *inputs, double const *desired
     for (h = ann->hidden_layers - 1; h >= 0; --h) {
 
         /* Find first output and delta in this layer. */
-        double const *o = ann->output + ann->inputs + (h * ann->hidden);
-        double *d = ann->delta + (h * ann->hidden);
+        double const *o = layer_outputs(ann, h);
+        double *d = layer_deltas(ann, h);
 
-        /* Find first delta in following layer (which may be hidden or output). */
-        double const * const dd = ann->delta + ((h+1) * ann->hidden);
+        /* Find first delta and weight in following layer (which may be hidden or output). */
+        double const * const dd = layer_deltas(ann, h+1);
+        double const * const ww = layer_weights(ann, h+1);
 
-        /* Find first weight in following layer (which may be hidden or output). */
-        double const * const ww = ann->weight + ((ann->inputs+1) * ann->hidden) + ((ann->hidden+1) * ann->hidden * (h));
+        /* Neuron j's weights to the following layer are the row of input j. */
+        double delta[layer_stride(ann, h)];
+        kernels->backward(delta, ww, layer_stride(ann, h+1), dd, layer_neurons(ann, h+1), ann->hidden);
 
         for (j = 0; j < ann->hidden; ++j) {
-
-            double delta = 0;
-
-            for (k = 0; k < (h == ann->hidden_layers-1 ? ann->outputs : ann->hidden); ++k) {
-                const double forward_delta = dd[k];
-                const int windex = k * (ann->hidden + 1) + (j + 1);
-                const double forward_weight = ww[windex];
-                delta += forward_delta * forward_weight;
-            }
-
-            *d = *o * (1.0-*o) * delta;
+            *d = *o * (1.0-*o) * delta[j];
             ++d; ++o;
         }
     }
+}
 
 
-    /* Train the outputs. */
-    {
-        /* Find first output delta. */
-        double const *d = ann->delta + ann->hidden * ann->hidden_layers; /* First output delta. */
-
-        /* Find first weight to first output delta. */
-        double *w = ann->weight + (ann->hidden_layers
-                ? ((ann->inputs+1) * ann->hidden + (ann->hidden+1) * ann->hidden * (ann->hidden_layers-1))
-                : (0));
-
-        /* Find first output in previous layer. */
-        double const * const i = ann->output + (ann->hidden_layers
-                ? (ann->inputs + (ann->hidden) * (ann->hidden_layers-1))
-                : 0);
-
-        /* Set output layer weights. */
-        for (j = 0; j < ann->outputs; ++j) {
-            *w++ += *d * learning_rate * -1.0;
-            for (k = 1; k < (ann->hidden_layers ? ann->hidden : ann->inputs) + 1; ++k) {
-                *w++ += *d * learning_rate * i[k-1];
-            }
+/* Layer l's deltas, padded with zeros to its stride for the kernels. */
+static void genann_padded_deltas(genann const *ann, int l, double *d) {
+    const int n = layer_neurons(ann, l);
+    memcpy(d, layer_deltas(ann, l), sizeof(double) * n);
+    memset(d + n, 0, sizeof(double) * (layer_stride(ann, l) - n));
+}
 
-            ++d;
-        }
 
-        assert(w - ann->weight == ann->total_weights);
+/* Trains the layers from 'first' on, whose inputs are in ann->output. */
+static void genann_train_from(genann const *ann, int first, double learning_rate) {
+    int l;
+    for (l = ann->hidden_layers; l >= first; --l) {
+        const int stride = layer_stride(ann, l);
+        double d[stride];
+        genann_padded_deltas(ann, l, d);
+        kernels->update(layer_weights(ann, l), stride, d, learning_rate, layer_input_values(ann, l), layer_inputs(ann, l));
     }
+}
 
 
-    /* Train the hidden layers. */
-    for (h = ann->hidden_layers - 1; h >= 0; --h) {
+void genann_train_cached(genann const *ann, double const *desired_outputs, double learning_rate) {
+    genann_set_deltas(ann, desired_outputs);
 
-        /* Find first delta in this layer. */
-        double const *d = ann->delta + (h * ann->hidden);
+    genann_train_from(ann, 0, learning_rate);
+}
 
-        /* Find first input to this layer. */
-        double const *i = ann->output + (h
-                ? (ann->inputs + ann->hidden * (h-1))
-                : 0);
 
-        /* Find first weight to this layer. */
-        double *w = ann->weight + (h
-                ? ((ann->inputs+1) * ann->hidden + (ann->hidden+1) * (ann->hidden) * (h-1))
-                : 0);
+void genann_train(genann const *ann, double const *inputs, double const *desired_outputs, double learning_rate) {
+    /* To begin with, we must run the network forward. */
+    genann_run(ann, inputs);
 
+    genann_train_cached(ann, desired_outputs, learning_rate);
+}
 
-        for (j = 0; j < ann->hidden; ++j) {
-            *w++ += *d * learning_rate * -1.0;
-            for (k = 1; k < (h == 0 ? ann->inputs : ann->hidden) + 1; ++k) {
-                *w++ += *d * learning_rate * i[k-1];
-            }
-            ++d;
+
+void genann_train_steps(genann const *ann, double const *inputs, double const *desired_outputs, double learning_rate,
+                        int steps, int have_activations) {
+    int step;
+    for (step = 0; step < steps; ++step) {
+        /* Only the first step can use the activations; the ones after it see new weights. */
+        if (step > 0 || !have_activations) {
+            genann_run(ann, inputs);
         }
+        genann_train_cached(ann, desired_outputs, learning_rate);
+    }
+}
 
+
+void genann_train_sparse_steps(genann const *ann, uint64_t const *bits, int binary_inputs, double const *dense,
+                               double const *desired_outputs, double learning_rate, int steps, int have_activations) {
+    int active[binary_inputs > 0 ? binary_inputs : 1];
+    int num_active = genann_active_inputs(bits, binary_inputs, active);
+    const int stride = layer_stride(ann, 0);
+    double d[stride];
+    int step;
+
+    for (step = 0; step < steps; ++step) {
+        /* Only the first step can use the activations; the ones after it see new weights. */
+        if (step > 0 || !have_activations) {
+            genann_run_first_sparse(ann, active, num_active, binary_inputs, dense);
+            genann_run_from(ann, 1);
+        }
+
+        genann_set_deltas(ann, desired_outputs);
+
+        genann_train_from(ann, 1, learning_rate);
+
+        /* Train the first layer.  An input of 0 would add 0 to its weight, so only the weights of
+         * the inputs that are 1, and of the dense inputs, change. */
+        genann_padded_deltas(ann, 0, d);
+        kernels->update_sparse(layer_weights(ann, 0), stride, d, learning_rate, active, num_active,
+                               dense, binary_inputs, ann->inputs - binary_inputs);
     }
+}
+
 
+void genann_train_sparse(genann const *ann, uint64_t const *bits, int binary_inputs, double const *dense,
+                         double const *desired_outputs, double learning_rate) {
+    genann_train_sparse_steps(ann, bits, binary_inputs, dense, desired_outputs, learning_rate, 1, 0);
 }
 
 
@@ -423,8 +850,6 @@ void genann_write(genann const *ann, FILE *out) {
 
     int i;
     for (i = 0; i < ann->total_weights; ++i) {
-        fprintf(out, " %.20e", ann->weight[i]);
+        fprintf(out, " %.20e", ann->weight[genann_weight_position(ann, i)]);
     }
 }
-
-
@@ -27,6 +27,7 @@
 #ifndef __GENANN_H__
 #define __GENANN_H__
 
+#include <stdint.h>
 #include <stdio.h>
 
 #ifdef __cplusplus
@@ -34,11 +35,16 @@ extern "C" {
 #endif
 
 #ifndef GENANN_RANDOM
-/* We use the following for uniform random numbers between 0 and 1.
- * If you have a better function, redefine this macro. */
-#define GENANN_RANDOM() (((double)rand())/RAND_MAX)
+/* We use the following for uniform random numbers between 0 and 1, drawn from the network's own
+ * generator (see genann_random).  If you have a better function, redefine this macro. */
+#define GENANN_RANDOM(ann) (((double)genann_random(ann))/2147483647)
 #endif
 
+/* The seed genann_init uses. */
+#define GENANN_DEFAULT_SEED 1
+
+#define GENANN_RANDOM_WORDS 31
+
 struct genann;
 
 typedef double (*genann_actfun)(const struct genann *ann, double a);
@@ -47,19 +53,28 @@ typedef struct genann {
     /* How many inputs, outputs, and hidden neurons. */
     int inputs, hidden_layers, hidden, outputs;
 
-    /* Which activation function to use for hidden neurons. Default: gennann_act_sigmoid_cached*/
+    /* Which activation function to use for hidden neurons. Default: gennann_act_sigmoid_cached.
+     * Only consulted when genann.c is built with GENANN_RUNTIME_ACTIVATION; otherwise the
+     * activation is picked at compile time (see genann.c). */
     genann_actfun activation_hidden;
 
-    /* Which activation function to use for output. Default: gennann_act_sigmoid_cached*/
+    /* Which activation function to use for output. Default: gennann_act_sigmoid_cached.  As
+     * for activation_hidden. */
     genann_actfun activation_output;
 
-    /* Total number of weights, and size of weights buffer. */
+    /* Total number of weights. */
     int total_weights;
 
+    /* Size of the weights buffer, which has each layer's weights padded for the SIMD kernels. */
+    int weight_size;
+
     /* Total number of neurons + inputs and size of output buffer. */
     int total_neurons;
 
-    /* All weights (total_weights long). */
+    /* All weights (weight_size long, 64-byte aligned).  Each layer's are stored by input, the
+     * bias first, with each input's weights to the layer's neurons padded with zeros to a
+     * multiple of 8; use genann_get_weights and genann_set_weights for them in genann's
+     * original order. */
     double *weight;
 
     /* Stores input array and output of each neuron (total_neurons long). */
@@ -68,20 +83,46 @@ typedef struct genann {
     /* Stores delta of each hidden and output neuron (total_neurons - inputs long). */
     double *delta;
 
+    /* The state of the network's random number generator. */
+    uint32_t random_state[GENANN_RANDOM_WORDS];
+    int random_front, random_rear;
+
 } genann;
 
-/* Creates and returns a new ann. */
+/* Creates and returns a new ann, with its weights drawn from a generator seeded with
+ * GENANN_DEFAULT_SEED. */
 genann *genann_init(int inputs, int hidden_layers, int hidden, int outputs);
 
+/* Creates and returns a new ann, with its weights drawn from a generator seeded with seed.  The
+ * same seed always gives the same weights, whatever other anns are doing on other threads. */
+genann *genann_init_seeded(int inputs, int hidden_layers, int hidden, int outputs, uint32_t seed);
+
 /* Creates ANN from file saved with genann_write. */
 genann *genann_read(FILE *in);
 
-/* Sets weights randomly. Called by init. */
+/* Sets weights randomly, from the ann's generator. Called by init. */
 void genann_randomize(genann *ann);
 
+/* Restarts the ann's random number generator from seed (0 is taken as 1). */
+void genann_seed(genann *ann, uint32_t seed);
+
+/* The ann's next random number, from 0 to 2^31-1; the sequence from seed s is the one glibc's
+ * rand() gives after srand(s).  A copy of an ann carries on the same sequence. */
+uint32_t genann_random(genann *ann);
+
 /* Returns a new copy of ann. */
 genann *genann_copy(genann const *ann);
 
+/* Copies the total_weights weights out of and into an ann, in genann's original order: each
+ * neuron's bias weight and then its input weights, neuron by neuron and layer by layer. */
+void genann_get_weights(genann const *ann, double *weights);
+void genann_set_weights(genann *ann, double const *weights);
+
+/* The name of the SIMD kernels genann_run and genann_train use: scalar, sse2, avx2 or avx512.
+ * They're picked by CPUID when the first ann is created, or by the GENANN_KERNELS environment
+ * variable, and give exactly the same results. */
+const char *genann_kernels_name(void);
+
 /* Frees the memory used by an ann. */
 void genann_free(genann *ann);
 
@@ -91,6 +132,34 @@ double const *genann_run(genann const *ann, double const *inputs);
 /* Does a single backprop update. */
 void genann_train(genann const *ann, double const *inputs, double const *desired_outputs, double learning_rate);
 
+/* Does a single backprop update from the activations the last genann_run left in ann->output,
+ * without running the network again; the same as genann_train on genann_run's inputs. */
+void genann_train_cached(genann const *ann, double const *desired_outputs, double learning_rate);
+
+/* Does steps backprop updates on the same inputs.  If have_activations is set, ann->output holds
+ * the activations of a genann_run on these inputs with the current weights, and the first step
+ * starts from them instead of running the network again.  The same as calling genann_train steps
+ * times. */
+void genann_train_steps(genann const *ann, double const *inputs, double const *desired_outputs, double learning_rate,
+                        int steps, int have_activations);
+
+/* Runs the feedforward algorithm on inputs whose first binary_inputs are each 0 or 1, given
+ * as bits (input k is bit k%64 of bits[k/64]), followed by the ann->inputs - binary_inputs
+ * inputs in dense.  The first layer only adds up the weights of the inputs that are 1, and
+ * the result is exactly genann_run's, but ann->output doesn't hold the inputs afterwards. */
+double const *genann_run_sparse(genann const *ann, uint64_t const *bits, int binary_inputs, double const *dense);
+
+/* Does a single backprop update on inputs given as for genann_run_sparse; of the first layer's
+ * weights, only those of the inputs that are 1 and of the dense inputs change.  The result is
+ * exactly genann_train's. */
+void genann_train_sparse(genann const *ann, uint64_t const *bits, int binary_inputs, double const *dense,
+                         double const *desired_outputs, double learning_rate);
+
+/* genann_train_steps for inputs given as for genann_run_sparse; have_activations means the last
+ * genann_run_sparse was on these inputs with the current weights. */
+void genann_train_sparse_steps(genann const *ann, uint64_t const *bits, int binary_inputs, double const *dense,
+                               double const *desired_outputs, double learning_rate, int steps, int have_activations);
+
 /* Saves the ann. */
 void genann_write(genann const *ann, FILE *out);
 
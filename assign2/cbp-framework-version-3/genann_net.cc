@@ -0,0 +1,425 @@
+/* Description: This file defines the neural nets of genann_net.h: genann
+ * itself, and GENANN_NET_T, genann's network with its weights and activations
+ * in float or in 16-bit fixed point.
+*/
+
+#include "genann_net.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "genann.h"
+
+using namespace std;
+
+namespace {
+
+// the build doesn't optimize, so the vector arithmetic of the formats is inlined into the loops
+// by hand
+#define ALWAYS_INLINE __attribute__((always_inline))
+// the clones must not fuse multiplies and adds (AVX-512F has FMA), or the results would depend on
+// the machine; the Makefile builds with -ffp-contract=off
+#define GENANN_NET_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+
+// genann itself, in double
+class genann_double_net_c final : public genann_net_c
+{
+private:
+    // not implemented
+    genann_double_net_c(const genann_double_net_c&);
+    genann_double_net_c& operator=(const genann_double_net_c&);
+
+    genann *ann;
+public:
+    genann_double_net_c(int inputs, int hidden_layers, int hidden, int outputs, uint32_t seed){
+        ann = genann_init_seeded(inputs, hidden_layers, hidden, outputs, seed);
+    }
+    ~genann_double_net_c(){ genann_free(ann); }
+
+    int weight_bits() const { return 64; }
+    int total_weights() const { return ann->total_weights; }
+    double run_sparse(const uint64_t *bits, int binary_inputs, const double *dense){
+        return *genann_run_sparse(ann, bits, binary_inputs, dense);
+    }
+    void train_sparse_steps(const uint64_t *bits, int binary_inputs, const double *dense,
+                            const double *desired_outputs, double learning_rate, int steps, bool have_activations){
+        genann_train_sparse_steps(ann, bits, binary_inputs, dense, desired_outputs, learning_rate, steps,
+                                  have_activations);
+    }
+    void get_weights(double *weights) const { genann_get_weights(ann, weights); }
+    void set_weights(const double *weights){ genann_set_weights(ann, weights); }
+};
+
+// The number formats of GENANN_NET_T.  Each gives the type of a weight or activation (value_t),
+// a vector of LANES of them (vec_t), a vector of LANES sums (sum_vec_t), and the arithmetic of the
+// forward pass and of backprop on them.  The activation is the sigmoid in both.  The vectors are
+// passed by reference, since passing 32-byte vectors by value changes with the instruction set.
+
+// single precision, with genann's arithmetic and its sigmoid lookup table
+class genann_float32_c
+{
+public:
+    static const int BITS = 32;
+    typedef float value_t;
+    typedef float delta_t;
+    typedef float weighted_sum_t;               // of a layer's deltas, for the layer below
+    typedef float rate_t;
+    typedef float vec_t __attribute__((vector_size(32)));
+    typedef vec_t sum_vec_t;
+    static constexpr value_t ONE = 1;
+
+    static value_t weight_from_double(double w){ return value_t(w); }
+    static double weight_to_double(value_t w){ return w; }
+    static ALWAYS_INLINE value_t value_from_double(double x){ return value_t(x); }
+    static double value_to_double(value_t x){ return x; }
+
+    // sum = -w, sum += w and sum += w * x
+    static ALWAYS_INLINE void start_sum(sum_vec_t &sum, const vec_t &w){ sum = -w; }
+    static ALWAYS_INLINE void add_weight(sum_vec_t &sum, const vec_t &w){ sum += w; }
+    static ALWAYS_INLINE void add_product(sum_vec_t &sum, const vec_t &w, value_t x){ sum += w * x; }
+    // genann's lookup table over -15 to 15, in single precision
+    static const value_t *sigmoid_table(){
+        static const vector<value_t> table = [] {
+            vector<value_t> t(4096);
+            genann_init_sigmoid_lookup(0);
+            for (int i = 0; i < 4096; ++i) {
+                t[i] = value_t(genann_act_sigmoid_cached(0, -15.0 + 30.0 * i / 4096));
+            }
+            return t;
+        }();
+        return table.data();
+    }
+    static ALWAYS_INLINE value_t activate(const value_t *table, float sum){
+        float j = (sum + 15.0f) * (4096 / 30.0f) + 0.5f;
+        return table[j < 0 ? 0 : j >= 4095 ? 4095 : int(j)];
+    }
+
+    static ALWAYS_INLINE delta_t output_delta(value_t o, value_t desired){ return (desired - o) * o * (1 - o); }
+    static ALWAYS_INLINE weighted_sum_t weighted_delta(value_t w, delta_t d){ return w * d; }
+    static ALWAYS_INLINE delta_t hidden_delta(value_t o, weighted_sum_t sum){ return o * (1 - o) * sum; }
+    static double min_learning_rate(){ return 0; }
+    static ALWAYS_INLINE rate_t rate(double learning_rate){ return rate_t(learning_rate); }
+    static ALWAYS_INLINE float scaled_delta(delta_t d, rate_t rate){ return d * rate; }
+    // w += dr * x, dr being each lane's scaled_delta
+    static ALWAYS_INLINE void update(vec_t &w, const sum_vec_t &dr, value_t x){ w += dr * x; }
+};
+
+// 16-bit two's complement fixed point: weights with 12 fraction bits (-8 to 8), activations and
+// inputs with 11 (-16 to 16, which holds the ghel counters), and deltas with 14.  Sums are formed
+// in 32 bits, and every result is narrowed back to 16 bits saturating.  A weight update smaller
+// than half a step of the weight is lost, as it would be in hardware, so this format wants a
+// larger learning rate than the others.
+class genann_fixed16_c
+{
+public:
+    static const int BITS = 16;
+    static const int WEIGHT_FRACTION = 12;
+    static const int VALUE_FRACTION = 11;
+    static const int DELTA_FRACTION = 14;
+    static const int SCALED_DELTA_FRACTION = 16;    // of delta * learning rate
+    static const int RATE_FRACTION = 30;
+    typedef int16_t value_t;
+    typedef int16_t delta_t;
+    typedef int64_t weighted_sum_t;
+    typedef int64_t rate_t;
+    typedef int16_t vec_t __attribute__((vector_size(16)));
+    typedef int32_t sum_vec_t __attribute__((vector_size(32)));
+    static constexpr value_t ONE = 1 << VALUE_FRACTION;
+
+    static int16_t saturate(int64_t x){ return int16_t(min<int64_t>(INT16_MAX, max<int64_t>(INT16_MIN, x))); }
+    static ALWAYS_INLINE void saturate(vec_t &result, const sum_vec_t &x){
+        const sum_vec_t lo = sum_vec_t{} + INT16_MIN, hi = sum_vec_t{} + INT16_MAX;
+        const sum_vec_t above = x < lo ? lo : x;
+        result = __builtin_convertvector(above > hi ? hi : above, vec_t);
+    }
+
+    static value_t weight_from_double(double w){ return saturate(llround(ldexp(w, WEIGHT_FRACTION))); }
+    static double weight_to_double(value_t w){ return ldexp(w, -WEIGHT_FRACTION); }
+    static ALWAYS_INLINE value_t value_from_double(double x){ return saturate(llround(ldexp(x, VALUE_FRACTION))); }
+    static double value_to_double(value_t x){ return ldexp(x, -VALUE_FRACTION); }
+
+    // sums have the weights' fraction bits
+    static ALWAYS_INLINE void start_sum(sum_vec_t &sum, const vec_t &w){ sum = -__builtin_convertvector(w, sum_vec_t); }
+    static ALWAYS_INLINE void add_weight(sum_vec_t &sum, const vec_t &w){ sum += __builtin_convertvector(w, sum_vec_t); }
+    static ALWAYS_INLINE void add_product(sum_vec_t &sum, const vec_t &w, value_t x){
+        sum += (__builtin_convertvector(w, sum_vec_t) * int32_t(x)) >> VALUE_FRACTION;
+    }
+    // the sum narrowed to 16 bits picks one of 4096 steps of the sigmoid from -8 to 8
+    static ALWAYS_INLINE value_t activate(const value_t *table, int32_t sum){
+        return table[(min(max(sum, int32_t(INT16_MIN)), int32_t(INT16_MAX)) - INT16_MIN) >> 4];
+    }
+    static const value_t *sigmoid_table(){
+        static const vector<value_t> table = [] {
+            vector<value_t> t(4096);
+            for (int i = 0; i < 4096; ++i) {
+                double x = ldexp(i * 16 + INT16_MIN + 8, -WEIGHT_FRACTION);
+                t[i] = value_from_double(1.0 / (1 + exp(-x)));
+            }
+            return t;
+        }();
+        return table.data();
+    }
+
+    static ALWAYS_INLINE delta_t output_delta(value_t o, value_t desired){
+        int64_t slope = (int64_t(o) * (ONE - o)) >> VALUE_FRACTION;
+        return saturate(((desired - o) * slope) >> (2 * VALUE_FRACTION - DELTA_FRACTION));
+    }
+    static ALWAYS_INLINE weighted_sum_t weighted_delta(value_t w, delta_t d){ return int64_t(w) * d; }
+    static ALWAYS_INLINE delta_t hidden_delta(value_t o, weighted_sum_t sum){
+        int64_t slope = (int64_t(o) * (ONE - o)) >> VALUE_FRACTION;
+        return saturate((slope * (sum >> WEIGHT_FRACTION)) >> VALUE_FRACTION);
+    }
+    // the rate at which the largest output delta, 4/27 (the most (desired - o) * o * (1 - o) can
+    // be), moves a weight fed an input of 1 by a whole step; below it most updates are lost
+    static double min_learning_rate(){ return ldexp(27.0 / 4, -WEIGHT_FRACTION); }
+    static ALWAYS_INLINE rate_t rate(double learning_rate){ return llround(ldexp(learning_rate, RATE_FRACTION)); }
+    static ALWAYS_INLINE int32_t scaled_delta(delta_t d, rate_t rate){
+        const int shift = DELTA_FRACTION + RATE_FRACTION - SCALED_DELTA_FRACTION;
+        const int64_t magnitude = (llabs(d * rate) + (int64_t(1) << (shift - 1))) >> shift;
+        return saturate(d < 0 ? -magnitude : magnitude);
+    }
+    // w += dr * x, rounded to the nearest step of the weight, halves away from zero so the lost
+    // parts of the updates don't push the weights one way
+    static ALWAYS_INLINE void update(vec_t &w, const sum_vec_t &dr, value_t x){
+        const int shift = SCALED_DELTA_FRACTION + VALUE_FRACTION - WEIGHT_FRACTION;
+        const sum_vec_t step = dr * int32_t(x);
+        const sum_vec_t zero = sum_vec_t{};
+        const sum_vec_t magnitude = ((step < zero ? -step : step) + (1 << (shift - 1))) >> shift;
+        saturate(w, __builtin_convertvector(w, sum_vec_t) + (step < zero ? -magnitude : magnitude));
+    }
+};
+
+// genann's network in another number format.  As in genann, each layer's weights are stored by
+// input, the bias first, and each input's weights to the layer's neurons are padded with zeros
+// to a whole number of vectors, so the forward pass and the updates work a vector of neurons at
+// a time.  Only the sigmoid activation is supported.
+template <class FORMAT>
+class GENANN_NET_T final : public genann_net_c
+{
+private:
+    // not implemented
+    GENANN_NET_T(const GENANN_NET_T&);
+    GENANN_NET_T& operator=(const GENANN_NET_T&);
+
+    typedef typename FORMAT::value_t value_t;
+    typedef typename FORMAT::delta_t delta_t;
+    typedef typename FORMAT::vec_t vec_t;
+    typedef typename FORMAT::sum_vec_t sum_vec_t;
+    static const int LANES = sizeof(vec_t) / sizeof(value_t);
+
+    const int inputs, hidden_layers, hidden, outputs;
+    int weights;
+    // 64-byte aligned: without AVX enabled, the compiler only aligns 32-byte vectors to 16, but
+    // the AVX versions of forward and train load them aligned
+    vec_t *weight;
+    std::vector<value_t> output;                // each layer's outputs, padded like its weights
+    std::vector<delta_t> delta;                 // likewise
+    std::vector<int> active;                    // the binary inputs that are 1, num_active of them
+    int num_active;
+    std::vector<value_t> dense_input;
+    int first_dense;
+    // where each layer's weights, and its outputs and deltas, start; one more entry for the end
+    std::vector<size_t> first_vec;
+    std::vector<size_t> first_output;
+
+    int layer_inputs(int l) const { return l == 0 ? inputs : hidden; }
+    int layer_neurons(int l) const { return l == hidden_layers ? outputs : hidden; }
+    int layer_vecs(int l) const { return (layer_neurons(l) + LANES - 1) / LANES; }
+    size_t layer_first_output(int l) const { return first_output[l]; }
+    // layer l's weights: the row of an input (0 for the bias) is layer_vecs(l) vectors long
+    vec_t *layer_rows(int l) { return weight + first_vec[l]; }
+    const vec_t *layer_rows(int l) const { return weight + first_vec[l]; }
+
+    void set_inputs(const uint64_t *bits, int binary_inputs, const double *dense){
+        int *a = active.data();
+        num_active = 0;
+        for (int word = 0; word * 64 < binary_inputs; ++word) {
+            uint64_t b = bits[word];
+            // the bits of the last word past binary_inputs aren't inputs
+            if (binary_inputs - word * 64 < 64) {
+                b &= (UINT64_C(1) << (binary_inputs - word * 64)) - 1;
+            }
+            for (; b; b &= b - 1) {
+                a[num_active++] = word * 64 + __builtin_ctzll(b);
+            }
+        }
+        first_dense = binary_inputs;
+        for (int k = 0; k < inputs - binary_inputs; ++k) {
+            dense_input[k] = FORMAT::value_from_double(dense[k]);
+        }
+    }
+
+    GENANN_NET_CLONES void forward(){
+        const int *a = active.data();
+        const value_t *dense = dense_input.data();
+        const int num_dense = inputs - first_dense;
+        const value_t *sigmoid = FORMAT::sigmoid_table();
+        for (int l = 0; l <= hidden_layers; ++l) {
+            const int vecs = layer_vecs(l), n = layer_neurons(l);
+            const vec_t *rows = layer_rows(l);
+            value_t *out = &output[layer_first_output(l)];
+            for (int v = 0; v < vecs; ++v) {
+                sum_vec_t sum;
+                FORMAT::start_sum(sum, rows[v]);
+                if (l == 0) {
+                    for (int k = 0; k < num_active; ++k) {
+                        FORMAT::add_weight(sum, rows[(a[k] + 1) * vecs + v]);
+                    }
+                    for (int k = 0; k < num_dense; ++k) {
+                        FORMAT::add_product(sum, rows[(first_dense + k + 1) * vecs + v], dense[k]);
+                    }
+                } else {
+                    const value_t *x = &output[layer_first_output(l - 1)];
+                    for (int k = 0; k < hidden; ++k) {
+                        FORMAT::add_product(sum, rows[(k + 1) * vecs + v], x[k]);
+                    }
+                }
+                for (int j = 0; j < LANES && v * LANES + j < n; ++j) {
+                    out[v * LANES + j] = FORMAT::activate(sigmoid, sum[j]);
+                }
+            }
+        }
+    }
+
+    // genann's backprop: every layer's deltas from the current weights, then the updates
+    GENANN_NET_CLONES void train(const double *desired_outputs, double learning_rate){
+        const value_t *o = &output[layer_first_output(hidden_layers)];
+        delta_t *d = &delta[layer_first_output(hidden_layers)];
+        for (int j = 0; j < outputs; ++j) {
+            d[j] = FORMAT::output_delta(o[j], FORMAT::value_from_double(desired_outputs[j]));
+        }
+        for (int l = hidden_layers - 1; l >= 0; --l) {
+            const delta_t *above = &delta[layer_first_output(l + 1)];
+            const vec_t *rows = layer_rows(l + 1);
+            const int vecs = layer_vecs(l + 1);
+            o = &output[layer_first_output(l)];
+            d = &delta[layer_first_output(l)];
+            for (int j = 0; j < hidden; ++j) {
+                typename FORMAT::weighted_sum_t sum = 0;
+                for (int k = 0; k < layer_neurons(l + 1); ++k) {
+                    sum += FORMAT::weighted_delta(rows[(j + 1) * vecs + k / LANES][k % LANES], above[k]);
+                }
+                d[j] = FORMAT::hidden_delta(o[j], sum);
+            }
+        }
+
+        const typename FORMAT::rate_t rate = FORMAT::rate(learning_rate);
+        const int *a = active.data();
+        const value_t *dense = dense_input.data();
+        const int num_dense = inputs - first_dense;
+        for (int l = 0; l <= hidden_layers; ++l) {
+            const int vecs = layer_vecs(l), n = layer_neurons(l);
+            vec_t *rows = layer_rows(l);
+            d = &delta[layer_first_output(l)];
+            for (int v = 0; v < vecs; ++v) {
+                sum_vec_t dr = sum_vec_t{};
+                for (int j = 0; j < LANES && v * LANES + j < n; ++j) {
+                    dr[j] = FORMAT::scaled_delta(d[v * LANES + j], rate);
+                }
+                FORMAT::update(rows[v], dr, -FORMAT::ONE);
+                if (l == 0) {
+                    for (int k = 0; k < num_active; ++k) {
+                        FORMAT::update(rows[(a[k] + 1) * vecs + v], dr, FORMAT::ONE);
+                    }
+                    for (int k = 0; k < num_dense; ++k) {
+                        FORMAT::update(rows[(first_dense + k + 1) * vecs + v], dr, dense[k]);
+                    }
+                } else {
+                    const value_t *x = &output[layer_first_output(l - 1)];
+                    for (int k = 0; k < hidden; ++k) {
+                        FORMAT::update(rows[(k + 1) * vecs + v], dr, x[k]);
+                    }
+                }
+            }
+        }
+    }
+
+public:
+    GENANN_NET_T(int inputs_arg, int hidden_layers_arg, int hidden_arg, int outputs_arg, uint32_t seed)
+      : inputs(inputs_arg), hidden_layers(hidden_layers_arg), hidden(hidden_arg), outputs(outputs_arg),
+        num_active(0), first_dense(0) {
+        first_vec.push_back(0);
+        first_output.push_back(0);
+        for (int l = 0; l <= hidden_layers; ++l) {
+            first_vec.push_back(first_vec.back() + size_t(layer_inputs(l) + 1) * layer_vecs(l));
+            first_output.push_back(first_output.back() + size_t(layer_vecs(l)) * LANES);
+        }
+        const size_t bytes = (first_vec.back() * sizeof(vec_t) + 63) / 64 * 64;
+        weight = static_cast<vec_t *>(aligned_alloc(64, bytes));
+        memset(weight, 0, bytes);
+        output.resize(first_output.back());
+        delta.resize(output.size());
+        active.resize(inputs);
+        dense_input.resize(inputs);
+        genann *ann = genann_init_seeded(inputs, hidden_layers, hidden, outputs, seed);
+        weights = ann->total_weights;
+        vector<double> initial(weights);
+        genann_get_weights(ann, initial.data());
+        genann_free(ann);
+        set_weights(initial.data());
+    }
+
+    ~GENANN_NET_T(){ free(weight); }
+
+    int weight_bits() const { return FORMAT::BITS; }
+    int total_weights() const { return weights; }
+
+    double run_sparse(const uint64_t *bits, int binary_inputs, const double *dense){
+        set_inputs(bits, binary_inputs, dense);
+        forward();
+        return FORMAT::value_to_double(output[layer_first_output(hidden_layers)]);
+    }
+    void train_sparse_steps(const uint64_t *bits, int binary_inputs, const double *dense,
+                            const double *desired_outputs, double learning_rate, int steps, bool have_activations){
+        if (!have_activations) {
+            set_inputs(bits, binary_inputs, dense);
+        }
+        for (int step = 0; step < steps; ++step) {
+            if (step > 0 || !have_activations) {
+                forward();
+            }
+            train(desired_outputs, learning_rate);
+        }
+    }
+
+    // in genann's order: each neuron's bias weight and then its input weights
+    void get_weights(double *w) const {
+        for (int l = 0; l <= hidden_layers; ++l) {
+            for (int j = 0; j < layer_neurons(l); ++j) {
+                for (int i = 0; i <= layer_inputs(l); ++i) {
+                    *w++ = FORMAT::weight_to_double(layer_rows(l)[i * layer_vecs(l) + j / LANES][j % LANES]);
+                }
+            }
+        }
+    }
+    void set_weights(const double *w){
+        for (int l = 0; l <= hidden_layers; ++l) {
+            for (int j = 0; j < layer_neurons(l); ++j) {
+                for (int i = 0; i <= layer_inputs(l); ++i) {
+                    layer_rows(l)[i * layer_vecs(l) + j / LANES][j % LANES] = FORMAT::weight_from_double(*w++);
+                }
+            }
+        }
+    }
+};
+
+} // namespace
+
+double genann_net_c::min_learning_rate(int weight_bits){
+    switch (weight_bits) {
+    case 32: return genann_float32_c::min_learning_rate();
+    case 16: return genann_fixed16_c::min_learning_rate();
+    }
+    return 0;
+}
+
+genann_net_c *genann_net_c::create(int weight_bits, int inputs, int hidden_layers, int hidden, int outputs,
+                                   uint32_t seed){
+    switch (weight_bits) {
+    case 64: return new genann_double_net_c(inputs, hidden_layers, hidden, outputs, seed);
+    case 32: return new GENANN_NET_T<genann_float32_c>(inputs, hidden_layers, hidden, outputs, seed);
+    case 16: return new GENANN_NET_T<genann_fixed16_c>(inputs, hidden_layers, hidden, outputs, seed);
+    }
+    return 0;
+}
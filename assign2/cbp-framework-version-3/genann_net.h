@@ -0,0 +1,44 @@
+/* Description: This file defines genann_net_c, the neural net the neural
+ * predictor trains.  Its weights and activations are doubles (genann itself),
+ * floats, or 16-bit fixed point numbers with saturating arithmetic, as a
+ * hardware neural predictor would keep them; see genann_net.cc.
+*/
+
+#ifndef GENANN_NET_H_SEEN
+#define GENANN_NET_H_SEEN
+
+#include <inttypes.h>
+
+// A network with one set of binary inputs and one of dense inputs, as for genann_run_sparse.
+// Whatever the format, the weights go in and out as doubles in genann's order, so a network
+// saved in one format can be loaded into another.
+class genann_net_c
+{
+public:
+    virtual ~genann_net_c() {}
+
+    // bits per weight: 64, 32 or 16
+    virtual int weight_bits() const = 0;
+    virtual int total_weights() const = 0;
+
+    // genann_run_sparse; returns the first output
+    virtual double run_sparse(const uint64_t *bits, int binary_inputs, const double *dense) = 0;
+    // genann_train_sparse_steps
+    virtual void train_sparse_steps(const uint64_t *bits, int binary_inputs, const double *dense,
+                                    const double *desired_outputs, double learning_rate, int steps,
+                                    bool have_activations) = 0;
+
+    // genann_get_weights and genann_set_weights; set_weights rounds them to the format
+    virtual void get_weights(double *weights) const = 0;
+    virtual void set_weights(const double *weights) = 0;
+
+    // the smallest learning rate at which a network with weight_bits bits per weight learns; 0 if
+    // any rate will do
+    static double min_learning_rate(int weight_bits);
+    // a network with weight_bits bits per weight, whose initial weights are genann_init_seeded's
+    // rounded to the format; 0 if weight_bits isn't 64, 32 or 16
+    static genann_net_c *create(int weight_bits, int inputs, int hidden_layers, int hidden, int outputs,
+                                uint32_t seed);
+};
+
+#endif // GENANN_NET_H_SEEN
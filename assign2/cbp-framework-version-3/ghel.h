@@ -0,0 +1,249 @@
+/* Description: This file defines the ghel predictor: PHT_COUNT tables of 4-bit
+ * counters, each indexed by a hash of the PC with a longer slice of global and
+ * path history than the one before it.  The prediction is the sign of the sum
+ * of the counters, and the counters are trained on a mispredict, or when the
+ * sum is below an adaptive threshold.  It is used on its own, and as the
+ * front end of the neural predictor in predictor.h.
+*/
+
+#ifndef GHEL_H_SEEN
+#define GHEL_H_SEEN
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <inttypes.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "predictor_base.h"
+
+template <int PHT_LENGTH_T, int PHT_COUNT_T>
+class GHEL_PREDICTOR_T final : public predictor_base_c
+{
+  public:
+    typedef uint32_t address_t;
+    typedef uint32_t history_t;
+    typedef int8_t counter_t;
+    typedef unsigned __int128 uint128_t;
+
+    static const int BHR_LENGTH = 64;  // 64 bits
+    static const int PHT_LENGTH = PHT_LENGTH_T;   // 2^PHT_LENGTH size pht table
+    static const int PHT_COUNT = PHT_COUNT_T;
+    static const std::size_t PHT_SIZE = (std::size_t(1) << PHT_LENGTH);
+
+  private:
+    const predictor_params_c params;
+    const counter_t TC_LENGTH;
+
+    bool prediction = false;
+    float prediction_value = 4;
+
+    uint128_t bhr;  // branch history register
+    history_t pahis;  // path history register
+    counter_t tc; // threshold counter
+    uint32_t theta; //threshold
+    // the tables, one after another in a single cache-aligned slab; 64K bits by default
+    counter_t *phts;
+
+    // the prediction context: each table's index for the branch predict() was last called for,
+    // and the counters there, which train() and get_counter() reuse, since neither the histories
+    // nor the tables change in between.  check() limits PHT_COUNT to 8, so the counters fit in
+    // the low half of a 16-byte vector.
+    std::size_t indices[PHT_COUNT];
+    alignas(16) counter_t counters[16];
+
+    counter_t *table(int pht_num) { return phts + std::size_t(pht_num) * PHT_SIZE; }
+    const counter_t *table(int pht_num) const { return phts + std::size_t(pht_num) * PHT_SIZE; }
+
+    void update_bhr(bool taken) { bhr <<= 1; if (taken) bhr |= 1; }
+    void update_pahis(address_t pc) { pahis <<= 1; pahis |= pc & 1; }
+    static std::size_t pht_index(address_t pc, uint128_t bhr, history_t pahis, int pht_num) {
+      std::size_t PHT_MASK = (size_t(1) << PHT_LENGTH)-1;
+      if(pht_num == 0) {
+        return static_cast<std::size_t>(pc & PHT_MASK);
+      }
+      uint32_t bhrBitCount = (pht_num==0 ? 0 : (uint32_t(1) << (pht_num-1)));
+      uint32_t pahisBitCount = std::min(uint32_t(16), bhrBitCount);
+      uint64_t append = pahis & ((1 << pahisBitCount) - 1);
+      append |= ((bhr & ((1 << bhrBitCount) - 1))  << pahisBitCount);
+      append |= (uint128_t(pc) << (bhrBitCount + pahisBitCount));
+
+      std::size_t ret = append & PHT_MASK;
+      append >>= PHT_LENGTH;
+      ret ^= (append & PHT_MASK);
+      append >>= PHT_LENGTH;
+      ret ^= (append & PHT_MASK);
+      return ret;
+    }
+    static bool counter_msb(counter_t cnt) { return (cnt >= 0); }
+    static counter_t counter_inc(counter_t cnt)
+        { if (cnt != 7) ++cnt; return cnt; }
+    static counter_t counter_dec(counter_t cnt)
+        { if (cnt != -8) --cnt; return cnt; }
+    void tc_inc(){
+      if (tc != ((counter_t(1) << (TC_LENGTH-1)) - 1))
+        ++tc;
+      else {
+        tc= 0;
+        ++theta;
+      }
+      return;
+    }
+    void tc_dec(){
+      if (tc != (counter_t(1) << (TC_LENGTH-1)))
+        --tc;
+      else {
+        tc= 0;
+        --theta;
+      }
+      return;
+    }
+
+    // the sum of the counters in the prediction context
+    int sum_counters() const {
+#ifdef __SSE2__
+      // offset each byte to unsigned and add them all up with psadbw; the unused bytes are 0,
+      // so all 16 bytes come out 128 over the counter
+      __m128i v = _mm_xor_si128(_mm_load_si128(reinterpret_cast<const __m128i *>(counters)), _mm_set1_epi8(char(0x80)));
+      __m128i sums = _mm_sad_epu8(v, _mm_setzero_si128());
+      return _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4) - 16 * 128;
+#else
+      int sum = 0;
+      for(int i=0; i<PHT_COUNT; ++i)
+        sum += counters[i];
+      return sum;
+#endif
+    }
+    // counts the counters in the prediction context up (or down), saturating at 7 (or -8)
+    void step_counters(bool taken) {
+#ifdef __SSE2__
+      __m128i v     = _mm_load_si128(reinterpret_cast<const __m128i *>(counters));
+      __m128i limit = _mm_set1_epi8(taken ? 7 : -8);
+      // the unused bytes have to stay 0 for sum_counters
+      __m128i used  = _mm_cmplt_epi8(_mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+                                     _mm_set1_epi8(PHT_COUNT));
+      __m128i step  = _mm_and_si128(_mm_set1_epi8(taken ? 1 : -1), used);
+      v = _mm_add_epi8(v, _mm_andnot_si128(_mm_cmpeq_epi8(v, limit), step));
+      _mm_store_si128(reinterpret_cast<__m128i *>(counters), v);
+#else
+      for(int i=0; i<PHT_COUNT; ++i)
+        counters[i] = taken ? counter_inc(counters[i]) : counter_dec(counters[i]);
+#endif
+    }
+
+  public:
+    static const bool USES_OP_STATE = false;
+    static const unsigned PARAMS = predictor_params_c::PHT_LENGTH_PARAM | predictor_params_c::PHT_COUNT_PARAM |
+                                   predictor_params_c::TC_LENGTH_PARAM;
+
+    // the geometry fields of params_arg are replaced by the template's
+    GHEL_PREDICTOR_T(const predictor_params_c &params_arg = predictor_params_c())
+      : params(with_geometry(params_arg)),
+        TC_LENGTH(params.tc_length),
+        bhr(0), pahis(0), tc(0), theta(PHT_COUNT/2) {
+      static_assert(PHT_COUNT <= 8, "the prediction context holds at most 8 counters");
+      phts = static_cast<counter_t *>(std::aligned_alloc(64, std::max(std::size_t(64), PHT_COUNT * PHT_SIZE)));
+      std::fill(phts, phts + PHT_COUNT * PHT_SIZE, counter_t(4));
+      std::fill(indices, indices + PHT_COUNT, std::size_t(0));
+      std::fill(counters, counters + 16, counter_t(0));
+    }
+    ~GHEL_PREDICTOR_T() { std::free(phts); }
+
+    static predictor_params_c with_geometry(predictor_params_c p) {
+      p.pht_length = PHT_LENGTH;
+      p.pht_count  = PHT_COUNT;
+      p.reported   = PARAMS;
+      return p;
+    }
+    const predictor_params_c &get_params() const { return params; }
+
+    // the bits of state, counting each counter as the 4 bits its values take and the path
+    // history as the 16 bits that are hashed
+    uint64_t state_bits() const {
+      return uint64_t(PHT_COUNT) * PHT_SIZE * 4 + BHR_LENGTH + 16 + TC_LENGTH + 32;
+    }
+
+    void save_state(checkpoint_writer_c* out) const {
+      out->write_value(int32_t(PHT_LENGTH));
+      out->write_value(int32_t(PHT_COUNT));
+      out->write_value(bhr);
+      out->write_value(pahis);
+      out->write_value(tc);
+      out->write_value(theta);
+      for(int i=0; i<PHT_COUNT; ++i) {
+        out->write_value(uint64_t(PHT_SIZE));     // as write_vector would
+        out->write(table(i), PHT_SIZE);
+      }
+    }
+    bool load_state(checkpoint_reader_c* in) {
+      if(!in->expect(int32_t(PHT_LENGTH), "pht_length") || !in->expect(int32_t(PHT_COUNT), "pht_count") ||
+         !in->read_value(&bhr) || !in->read_value(&pahis) || !in->read_value(&tc) || !in->read_value(&theta)) {
+        return false;
+      }
+      for(int i=0; i<PHT_COUNT; ++i) {
+        if(!in->expect(uint64_t(PHT_SIZE), "table size") || !in->read(table(i), PHT_SIZE))
+          return false;
+      }
+      return true;
+    }
+
+    // the pieces the neural predictor is built from
+    uint128_t get_bhr() const { return bhr; }
+    history_t get_pahis() const { return pahis; }
+    // the counter of table pht_num that the last call to predict() read
+    counter_t get_counter(int pht_num) const { return counters[pht_num]; }
+    bool get_last_prediction() const { return prediction; }
+
+    // predicts a conditional branch at pc, filling in the prediction context
+    bool predict(address_t pc) {
+      for(int i=0; i<PHT_COUNT; ++i){
+        indices[i] = pht_index(pc, bhr, pahis, i);
+        counters[i] = table(i)[indices[i]];
+      }
+      prediction_value = 4 + sum_counters(); // weekly taken bias
+      prediction = (prediction_value >= 0 ? true : false);
+      return prediction;
+    }
+    // trains the counters and the threshold on the outcome of the branch predict() was called for;
+    // the histories are left alone
+    void train(address_t pc, bool taken) {
+      if(prediction != taken || abs(prediction_value) < theta) {
+        step_counters(taken);
+        for(int i=0; i<PHT_COUNT; ++i){
+          table(i)[indices[i]] = counters[i];
+        }
+      }
+      if(prediction != taken) {
+        tc_inc();
+      } else if (abs(prediction_value) <= theta) {
+        tc_dec();
+      }
+    }
+    void update_history(address_t pc, bool taken) {
+      update_bhr(taken);
+      update_pahis(pc);
+    }
+
+    bool get_prediction(const branch_record_c* br, const op_state_c* os)
+        {
+            prediction = false;
+            if (/* conditional branch */ br->is_conditional) {
+              predict(br->instruction_addr);
+            }
+            return prediction;   // true for taken, false for not taken
+        }
+
+    void update_predictor(const branch_record_c* br, const op_state_c* os, bool taken)
+        {
+          address_t pc = br->instruction_addr;
+          if (/* conditional branch */ br->is_conditional) {
+            train(pc, taken);
+            update_history(pc, taken);
+          } else if (br->is_return || br->is_call) {
+            update_history(pc, true);
+          }
+        }
+};
+
+#endif // GHEL_H_SEEN
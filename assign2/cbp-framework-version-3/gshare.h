@@ -0,0 +1,94 @@
+/* Author: Jared Stark;   Created: Tue Jul 27 13:39:15 PDT 2004
+ * Description: This file defines a gshare branch predictor.
+*/
+
+#ifndef GSHARE_H_SEEN
+#define GSHARE_H_SEEN
+
+#include <cstddef>
+#include <inttypes.h>
+#include <vector>
+#include "predictor_base.h"
+
+// the framework's original example predictor: a 15-bit gshare with 2-bit counters.  It takes no
+// parameters; get_params() reports its one table of 2^15 counters as pht_length and pht_count.
+class GSHARE_PREDICTOR final : public predictor_base_c
+{
+  public:
+    typedef uint32_t address_t;
+
+  private:
+    typedef uint32_t history_t;
+    typedef uint8_t counter_t;
+
+    static const int BHR_LENGTH = 15;
+    static const history_t BHR_MSB = (history_t(1) << (BHR_LENGTH - 1));
+    static const std::size_t PHT_SIZE = (std::size_t(1) << BHR_LENGTH);
+    static const std::size_t PHT_INDEX_MASK = (PHT_SIZE - 1);
+    static const counter_t PHT_INIT = /* weakly taken */ 2;
+
+    const predictor_params_c params;
+    history_t bhr;                // 15 bits
+    std::vector<counter_t> pht;   // 64K bits
+
+    void update_bhr(bool taken) { bhr >>= 1; if (taken) bhr |= BHR_MSB; }
+    static std::size_t pht_index(address_t pc, history_t bhr)
+        { return (static_cast<std::size_t>(pc ^ bhr) & PHT_INDEX_MASK); }
+    static bool counter_msb(/* 2-bit counter */ counter_t cnt) { return (cnt >= 2); }
+    static counter_t counter_inc(/* 2-bit counter */ counter_t cnt)
+        { if (cnt != 3) ++cnt; return cnt; }
+    static counter_t counter_dec(/* 2-bit counter */ counter_t cnt)
+        { if (cnt != 0) --cnt; return cnt; }
+
+  public:
+    static const bool USES_OP_STATE = false;
+
+    static const unsigned PARAMS = 0;
+
+    GSHARE_PREDICTOR(const predictor_params_c &params_arg = predictor_params_c())
+        : params(with_geometry(params_arg)), bhr(0), pht(PHT_SIZE, counter_t(PHT_INIT)) {}
+
+    static predictor_params_c with_geometry(predictor_params_c p) {
+        p.pht_length = BHR_LENGTH;
+        p.pht_count  = 1;
+        p.reported   = predictor_params_c::PHT_LENGTH_PARAM | predictor_params_c::PHT_COUNT_PARAM;
+        return p;
+    }
+
+    const predictor_params_c &get_params() const { return params; }
+    uint64_t state_bits() const { return BHR_LENGTH + uint64_t(PHT_SIZE) * 2; }
+
+    void save_state(checkpoint_writer_c* out) const
+        { out->write_value(bhr); out->write_vector(pht); }
+    bool load_state(checkpoint_reader_c* in)
+        { return in->read_value(&bhr) && in->read_vector(&pht); }
+
+    bool get_prediction(const branch_record_c* br, const op_state_c* os)
+        {
+            bool prediction = false;
+            if (/* conditional branch */ br->is_conditional) {
+                address_t pc = br->instruction_addr;
+                std::size_t index = pht_index(pc, bhr);
+                counter_t cnt = pht[index];
+                prediction = counter_msb(cnt);
+            }
+            return prediction;   // true for taken, false for not taken
+        }
+
+    void update_predictor(const branch_record_c* br, const op_state_c* os, bool taken)
+        {
+            if (/* conditional branch */ br->is_conditional) {
+                address_t pc = br->instruction_addr;
+                std::size_t index = pht_index(pc, bhr);
+                counter_t cnt = pht[index];
+                if (taken)
+                    cnt = counter_inc(cnt);
+                else
+                    cnt = counter_dec(cnt);
+                pht[index] = cnt;
+                update_bhr(taken);
+            }
+        }
+};
+
+#endif // GSHARE_H_SEEN
@@ -5,6 +5,7 @@
 #ifndef INDIRECT_PRED_H_SEEN
 #define INDIRECT_PRED_H_SEEN
 
+#include <algorithm>
 #include <cstddef>
 #include <inttypes.h>
 
@@ -36,6 +37,9 @@ namespace cbp
       public:
         INDIRECT_PRED(void) { }
         // uses compiler generated destructor
+
+        // returns the predictor to its initial state
+        void reset(void) { std::fill_n(table, SIZE, ENTRY()); }
      
         uint64_t get_prediction(uint64_t vip) const;
         void train(uint64_t vip, uint64_t address);
@@ -2,46 +2,313 @@
  * Description: Branch predictor driver.
 */
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <type_traits>
+#include "bench.h"
+#include "fanout.h"
 #include "tread.h"
 
-// include and define the predictor
-#include "predictor.h"
-PREDICTOR predictor;
+// include the predictors and the geometries they're built for; one is picked once the
+// options are known
+#include "predictor_registry.h"
 
-// usage: predictor <trace>
-int
-main(int argc, char* argv[])
+static void
+usage(const char* prog)
 {
-    using namespace std;
+    printf("usage: %s [options] <trace>\n", prog);
+    printf("  --decode-threads=N   decompress the trace on N threads (default: one per core)\n");
+    printf("  --pipeline           decode the trace on its own thread, ahead of the predictor\n");
+    printf("  --skip-insts=N       start the trace at instruction N\n");
+    printf("  --stop-insts=N       end the trace after instruction N\n");
+    printf("  --save-checkpoint=FILE  save the predictor's state to FILE at the end of the run\n");
+    printf("  --load-checkpoint=FILE  start the predictor from the state saved in FILE\n");
+    printf("  --predictor-threads=N  run the second and later --predictor on N threads (default: 0, inline)\n");
+    printf("  --sample             simulate sampled intervals only (see the options below)\n");
+    printf("  --sample-period=N    start a sampled interval every N instructions (default: 1000000)\n");
+    printf("  --sample-length=N    measure N instructions per interval (default: 100000)\n");
+    printf("  --sample-warmup=N    train without scoring for N instructions first (default: 200000)\n");
+    printf("  --params=FILE        read predictor parameters from FILE (see predictor_params.h)\n");
+    printf("  --param=NAME=VALUE   set a predictor parameter; applied after --params, to the predictors\n");
+    printf("                       that take it\n");
+    printf("  --profile-interval=N print the mispredicts in each interval of N instructions\n");
+    printf("  --profile-top=K      print the K static branches with the most mispredicts\n");
+    printf("  --bench              time decode, predict and update for each branch and print the distributions\n");
+    printf("  --bench-counters     --bench, also counting cycles, instructions and misses in each phase\n");
+    printf("  --predictor=NAME[,NAME=VALUE...]\n");
+    printf("                       run the named predictor (default: %s), with its own parameters\n",
+           DEFAULT_PREDICTOR);
+    printf("                       applied after --param; repeat it to run several in one pass.\n");
+    printf("                       A parameter the predictor doesn't take is an error.\n");
+    printf("  --list-predictors    list the predictors\n");
+    printf("  --geometry=NAME      use one of the built-in table geometries; applied before --param\n");
+    printf("  --list-geometries    list the built-in table geometries\n");
+    exit(EXIT_FAILURE);
+}
 
-    if (2 != argc) {
-        printf("usage: %s <trace>\n", argv[0]);
-        exit(EXIT_FAILURE);
+// where a run's predictors start from and where the one reported on is saved at the end; either
+// may be 0
+class checkpoint_paths_c
+{
+public:
+    const char* predictor_name;
+    const char* load;
+    const char* save;
+};
+
+// one --predictor: the predictor's name and the parameters it's built with
+class predictor_spec_c
+{
+public:
+    std::string name;
+    predictor_params_c params;
+    bool uses_op_state;
+};
+
+// runs the trace through a predictor of class P, one of those in predictor_registry.h; the
+// driver loop is compiled for each of them, so the calls to the predictor are direct.  The
+// others, if any, run alongside it in the same pass over the trace.
+template <class P>
+static void
+run_trace(const predictor_params_c& params, char* trace_name, cbp_reader_config_c config,
+          const std::vector<predictor_spec_c>& others, int predictor_threads, int bench,
+          const checkpoint_paths_c& checkpoint)
+{
+    // skip the op_state bookkeeping for predictors that don't use it; pipelining
+    // needs that too, since op_state would run ahead of the predictor
+    config.maintain_op_state = P::USES_OP_STATE;
+    for (size_t i = 0; i < others.size(); i++)
+        config.maintain_op_state = config.maintain_op_state || others[i].uses_op_state;
+    if (config.pipelined && config.maintain_op_state) {
+        printf("--pipeline ignored: the predictor uses op_state\n");
+        config.pipelined = false;
     }
+    if (predictor_threads && config.maintain_op_state) {
+        printf("--predictor-threads ignored: a predictor uses op_state\n");
+        predictor_threads = 0;
+    }
+
+    P predictor(params);
+    if (checkpoint.load && !load_checkpoint(&predictor, checkpoint.load, checkpoint.predictor_name))
+        exit(EXIT_FAILURE);
 
-    cbp_trace_reader_c cbptr = cbp_trace_reader_c(argv[1]);
-    branch_record_c br;
+    if (bench) {
+        if (!others.empty())
+            printf("all but the first --predictor ignored: --bench times a single predictor\n");
+        bench_trace(&predictor, trace_name, config, bench > 1);
+    } else if (!others.empty()) {
+        // one pass over the trace for all the predictors; the trace reader reports on the first
+        std::vector<predictor_instance_c> instances;
+        for (size_t i = 0; i < others.size(); i++)
+            instances.push_back(predictor_instance_c(create_predictor(others[i].name.c_str(), others[i].params),
+                                                     others[i].name.c_str()));
+        predictor_fanout_c<P> fanout(&predictor, checkpoint.predictor_name, instances, predictor_threads);
+        if (checkpoint.load && !fanout.load_checkpoint(checkpoint.load))
+            exit(EXIT_FAILURE);
+        uint num_insts;
+        {
+            cbp_trace_reader_c cbptr(trace_name, config);
+            branch_record_c br;
+            while (cbptr.get_branch_record(&br)) {
+                bool predicted_taken = fanout.get_prediction(&br, cbptr.osptr);
+                bool actual_taken    = cbptr.predict_branch(predicted_taken);
+                fanout.update_predictor(&br, cbptr.osptr, actual_taken, cbptr.is_branch_scored());
+            }
+            fanout.finish();
+            num_insts = cbptr.num_scored_insts();
+        }
+        fanout.print_statistics(num_insts);
+    } else {
+        cbp_trace_reader_c cbptr = cbp_trace_reader_c(trace_name, config);
+        branch_record_c br;
 
-    // read the trace, one branch at a time, placing the branch info in br
-    while (cbptr.get_branch_record(&br)) {
+        // read the trace, one branch at a time, placing the branch info in br
+        while (cbptr.get_branch_record(&br)) {
 
-        // ************************************************************
-        // Competing predictors must have the following methods:
-        // ************************************************************
+            // ************************************************************
+            // Competing predictors must have the following methods:
+            // ************************************************************
 
-        // get_prediction() returns the prediction your predictor would like to make
-        bool predicted_taken = predictor.get_prediction(&br, cbptr.osptr);
+            // get_prediction() returns the prediction your predictor would like to make
+            bool predicted_taken = predictor.get_prediction(&br, cbptr.osptr);
 
-        // predict_branch() tells the trace reader how you have predicted the branch
-        bool actual_taken    = cbptr.predict_branch(predicted_taken);
+            // predict_branch() tells the trace reader how you have predicted the branch
+            bool actual_taken    = cbptr.predict_branch(predicted_taken);
             
-        // finally, update_predictor() is used to update your predictor with the
-        // correct branch result
-        predictor.update_predictor(&br, cbptr.osptr, actual_taken);
+            // finally, update_predictor() is used to update your predictor with the
+            // correct branch result
+            predictor.update_predictor(&br, cbptr.osptr, actual_taken);
+        }
     }
+
+    if (checkpoint.save && !save_checkpoint(predictor, checkpoint.save, checkpoint.predictor_name))
+        exit(EXIT_FAILURE);
 }
 
+// usage: predictor [options] <trace>
+int
+main(int argc, char* argv[])
+{
+    using namespace std;
 
+    cbp_reader_config_c config;
+    char* trace_name = 0;
+    bool sample = false;
+    int predictor_threads = 0;
+    unsigned long long sample_period = 1000000;
+    unsigned long long sample_length = 100000;
+    unsigned long long sample_warmup = 200000;
+    predictor_params_c params;
+    const char* params_name = 0;
+    const char* geometry_name = 0;
+    vector<const char*> predictor_args;  // each --predictor=NAME[,NAME=VALUE...]
+    int bench = 0;                      // 1 for --bench, 2 for --bench-counters
+    checkpoint_paths_c checkpoint = { 0, 0, 0 };
+    vector<const char*> param_settings;
+    for (int i = 1; i < argc; i++) {
+        if (0 == strncmp(argv[i], "--decode-threads=", 17)) {
+            config.decode_threads = atoi(argv[i] + 17);
+        } else if (0 == strcmp(argv[i], "--pipeline")) {
+            config.pipelined = true;
+        } else if (0 == strncmp(argv[i], "--skip-insts=", 13)) {
+            config.skip_insts = strtoull(argv[i] + 13, 0, 10);
+        } else if (0 == strncmp(argv[i], "--stop-insts=", 13)) {
+            config.stop_insts = strtoull(argv[i] + 13, 0, 10);
+        } else if (0 == strncmp(argv[i], "--save-checkpoint=", 18)) {
+            checkpoint.save = argv[i] + 18;
+        } else if (0 == strncmp(argv[i], "--load-checkpoint=", 18)) {
+            checkpoint.load = argv[i] + 18;
+        } else if (0 == strncmp(argv[i], "--predictor-threads=", 20)) {
+            predictor_threads = atoi(argv[i] + 20);
+        } else if (0 == strcmp(argv[i], "--sample")) {
+            sample = true;
+        } else if (0 == strncmp(argv[i], "--sample-period=", 16)) {
+            sample = true;
+            sample_period = strtoull(argv[i] + 16, 0, 10);
+        } else if (0 == strncmp(argv[i], "--sample-length=", 16)) {
+            sample = true;
+            sample_length = strtoull(argv[i] + 16, 0, 10);
+        } else if (0 == strncmp(argv[i], "--sample-warmup=", 16)) {
+            sample = true;
+            sample_warmup = strtoull(argv[i] + 16, 0, 10);
+        } else if (0 == strncmp(argv[i], "--params=", 9)) {
+            params_name = argv[i] + 9;
+        } else if (0 == strncmp(argv[i], "--profile-interval=", 19)) {
+            config.profile_interval = strtoull(argv[i] + 19, 0, 10);
+        } else if (0 == strncmp(argv[i], "--profile-top=", 14)) {
+            config.profile_top = atoi(argv[i] + 14);
+        } else if (0 == strcmp(argv[i], "--bench")) {
+            bench = max(bench, 1);
+        } else if (0 == strcmp(argv[i], "--bench-counters")) {
+            bench = 2;
+        } else if (0 == strncmp(argv[i], "--predictor=", 12)) {
+            predictor_args.push_back(argv[i] + 12);
+        } else if (0 == strcmp(argv[i], "--list-predictors")) {
+            print_predictor_engines(stdout);
+            exit(EXIT_SUCCESS);
+        } else if (0 == strncmp(argv[i], "--geometry=", 11)) {
+            geometry_name = argv[i] + 11;
+        } else if (0 == strcmp(argv[i], "--list-geometries")) {
+            print_predictor_geometries(stdout);
+            exit(EXIT_SUCCESS);
+        } else if (0 == strncmp(argv[i], "--param=", 8)) {
+            param_settings.push_back(argv[i] + 8);
+        } else if (('-' != argv[i][0]) && !trace_name) {
+            trace_name = argv[i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (!trace_name || (sample && sample_period == 0) || predictor_threads < 0) {
+        usage(argv[0]);
+    }
+    if (params_name && !params.load(params_name)) {
+        exit(EXIT_FAILURE);
+    }
+    if (geometry_name && !set_predictor_geometry(geometry_name, &params)) {
+        printf("unknown predictor geometry: %s\n", geometry_name);
+        usage(argv[0]);
+    }
+    unsigned common_settings = 0;      // the bits of the --param parameters
+    for (size_t i = 0; i < param_settings.size(); i++) {
+        if (!params.set(param_settings[i])) {
+            printf("bad predictor parameter: %s\n", param_settings[i]);
+            usage(argv[0]);
+        }
+        common_settings |= predictor_params_c::param_bit(param_settings[i]);
+    }
+    if (predictor_args.empty()) {
+        predictor_args.push_back(DEFAULT_PREDICTOR);
+    }
+    // each --predictor's name, then its own settings, applied over the common parameters
+    vector<predictor_spec_c> predictors;
+    unsigned taken = 0;                // the bits of the parameters any of them takes
+    for (size_t i = 0; i < predictor_args.size(); i++) {
+        predictor_spec_c spec;
+        string arg = predictor_args[i];
+        size_t comma = arg.find(',');
+        spec.name = arg.substr(0, comma);
+        spec.params = params;
+        unsigned settings = 0;         // the bits of the parameters set for this one alone
+        while (comma != string::npos) {
+            size_t next = arg.find(',', comma + 1);
+            string setting = arg.substr(comma + 1, next == string::npos ? string::npos : next - comma - 1);
+            if (!spec.params.set(setting.c_str())) {
+                printf("bad predictor parameter: %s\n", setting.c_str());
+                usage(argv[0]);
+            }
+            settings |= predictor_params_c::param_bit(setting.c_str());
+            comma = next;
+        }
+        if (!find_predictor_engine(spec.name.c_str())) {
+            printf("unknown predictor: %s\n", spec.name.c_str());
+            usage(argv[0]);
+        }
+        if (!spec.params.check()) {
+            exit(EXIT_FAILURE);
+        }
+        spec.uses_op_state = false;
+        unsigned spec_params = 0;
+        if (!dispatch_predictor(spec.name.c_str(), spec.params, [&](auto* engine) {
+                typedef typename std::remove_pointer<decltype(engine)>::type P;
+                spec.uses_op_state = P::USES_OP_STATE;
+                spec_params = P::PARAMS;
+            })) {
+            printf("the %s predictor isn't built for this geometry (%s); add it to predictor_matrix.h\n",
+                   spec.name.c_str(), spec.params.to_string().c_str());
+            exit(EXIT_FAILURE);
+        }
+        if (settings & ~spec_params) {
+            predictor_params_c not_taken = spec.params;
+            not_taken.reported = settings & ~spec_params;
+            printf("the %s predictor doesn't take these parameters: %s\n", spec.name.c_str(),
+                   not_taken.to_string().c_str());
+            exit(EXIT_FAILURE);
+        }
+        taken |= spec_params;
+        predictors.push_back(spec);
+    }
+    if (common_settings & ~taken) {
+        predictor_params_c not_taken = params;
+        not_taken.reported = common_settings & ~taken;
+        printf("no --predictor takes these parameters: %s\n", not_taken.to_string().c_str());
+        exit(EXIT_FAILURE);
+    }
+    if (sample) {
+        config.sample_period = sample_period;
+        config.sample_length = sample_length;
+        config.sample_warmup = sample_warmup;
+    }
+    const predictor_spec_c& reported = predictors[0];
+    vector<predictor_spec_c> others(predictors.begin() + 1, predictors.end());
+    checkpoint.predictor_name = reported.name.c_str();
 
+    dispatch_predictor(reported.name.c_str(), reported.params, [&](auto* engine) {
+        typedef typename std::remove_pointer<decltype(engine)>::type P;
+        run_trace<P>(reported.params, trace_name, config, others, predictor_threads, bench, checkpoint);
+    });
+}
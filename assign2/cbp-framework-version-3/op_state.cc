@@ -43,7 +43,7 @@ void op_record_c::debug_print(){
 
 
 // methods for getting data values prevent the user from getting values before it is time
-bool op_record_c::are_values_available(){
+bool op_record_c::are_values_available() const{
     uint time_available = (clock_time_set + osptr->inst_delay);
     if(time_available > osptr->get_clock()){
         return false;
@@ -55,7 +55,7 @@ void op_record_c::set_src1_val(uint new_src1_val){
     src1_val = new_src1_val;
     clock_time_set = osptr->get_clock();
 }
-uint op_record_c::get_src1_val(){   
+uint op_record_c::get_src1_val() const{   
     if(!are_values_available()){
         uint time_available = (clock_time_set + osptr->inst_delay);
         printf("get_src1_val called before src1_val available %8d > %8d\n", time_available, osptr->get_clock());
@@ -68,7 +68,7 @@ void op_record_c::set_src2_val(uint new_src2_val){
     src2_val = new_src2_val;
     clock_time_set = osptr->get_clock();
 }
-uint op_record_c::get_src2_val(){
+uint op_record_c::get_src2_val() const{
     if(!are_values_available()){
         uint time_available = (clock_time_set + osptr->inst_delay);
         printf("get_src2_val called before src2_val available %8d > %8d\n", time_available, osptr->get_clock());
@@ -81,7 +81,7 @@ void op_record_c::set_dst_val(uint new_dst_val){
     dst_val = new_dst_val;
     clock_time_set = osptr->get_clock();
 }
-uint op_record_c::get_dst_val(){
+uint op_record_c::get_dst_val() const{
     if(!are_values_available()){
         uint time_available = (clock_time_set + osptr->inst_delay);
         printf("get_dst_val called before dst_val available %8d > %8d\n", time_available, osptr->get_clock());
@@ -94,7 +94,7 @@ void op_record_c::set_src_vaddr(uint new_src_vaddr){
     src_vaddr = new_src_vaddr;
     clock_time_set = osptr->get_clock();
 }
-uint op_record_c::get_src_vaddr(){
+uint op_record_c::get_src_vaddr() const{
     if(!are_values_available()){
         uint time_available = (clock_time_set + osptr->inst_delay);
         printf("get_src_vaddr called before src_vaddr available %8d > %8d\n", time_available, osptr->get_clock());
@@ -107,7 +107,7 @@ void op_record_c::set_dst_vaddr(uint new_dst_vaddr){
     dst_vaddr = new_dst_vaddr;
     clock_time_set = osptr->get_clock();
 }
-uint op_record_c::get_dst_vaddr(){
+uint op_record_c::get_dst_vaddr() const{
     if(!are_values_available()){
         uint time_available = (clock_time_set + osptr->inst_delay);
         printf("get_dst_vaddr called before dst_vaddr available %8d > %8d\n", time_available, osptr->get_clock());
@@ -117,33 +117,113 @@ uint op_record_c::get_dst_vaddr(){
 }
 
 // op_state methods
-op_state_c::op_state_c(){
+op_state_c::op_state_c() : regs(this), regs_valid(this), op_list(this){
     clock       = 0;
 
     num_regs    = g_num_regs;
     inst_delay  = g_inst_delay;
     num_ops     = g_num_ops;
+    // get_op_record and insert_op rely on the op list being a power-of-two ring that holds
+    // exactly the ops whose values are not yet visible
+    assert((num_ops & (num_ops - 1)) == 0);
+    assert(inst_delay == num_ops);
+    op_mask     = num_ops - 1;
 
-    regs        = new uint[num_regs];
-    regs_valid  = new bool[num_regs];
     for(uint i = 0; i < num_regs; i++){
-        regs[i]       = 0;
-        regs_valid[i] = false;
+        reg_state[i]        = 0;
+        reg_writer_clock[i] = 0;
     }
+    flag_writer_clock = 0;
     op_list_ptr = 0;
-    op_list     = new op_record_c[num_ops];
+    memset(op_clock_time_set, 0, sizeof(op_clock_time_set));
+    memset(op_flags, 0, sizeof(op_flags));
+    op_views_filled = 0;
 }
 op_state_c::~op_state_c(){
-    delete [] regs;
-    delete [] regs_valid;
-    delete [] op_list;
 }
 void op_state_c::init(op_state_c *new_osptr){
     assert(this == new_osptr);
     for(uint i = 0; i < num_ops; i++){
-        op_list[i].set_op_state(new_osptr);
+        op_views[i].set_op_state(new_osptr);
     } 
 }
+void op_state_c::insert_op(const cbp::CBP_INST &inst){
+    inc_clock();
+    uint i = op_list_ptr;
+    op_views_filled &= ~(uint64_t(1) << i);
+    //commit op
+    if((op_flags[i] & OP_IS_VALID) && op_dst[i] != REG_NUL){
+        reg_state[op_dst[i]] = REG_VALID | op_dst_val[i];
+    }
+    op_flags[i]            = OP_IS_VALID
+                           | (inst.is_load     ? OP_IS_LOAD     : 0)
+                           | (inst.is_store    ? OP_IS_STORE    : 0)
+                           | (inst.is_branch   ? OP_IS_BRANCH   : 0)
+                           | (inst.is_op       ? OP_IS_OP       : 0)
+                           | (inst.is_fp       ? OP_IS_FP       : 0)
+                           | (inst.read_flg    ? OP_READ_FLG    : 0)
+                           | (inst.writ_flg    ? OP_WRIT_FLG    : 0)
+                           | (inst.has_mem_src ? OP_HAS_MEM_SRC : 0)
+                           | (inst.has_mem_dst ? OP_HAS_MEM_DST : 0);
+    op_clock_time_set[i]   = clock;
+    op_instruction_addr[i] = inst.instruction_addr;
+    op_class_list[i]       = inst.op_class;
+    op_src1[i]             = inst.src1;
+    op_src2[i]             = inst.src2;
+    op_dst[i]              = inst.dst;
+    op_mem_src1[i]         = inst.mem_src1;
+    op_mem_src2[i]         = inst.mem_src2;
+    op_mem_src3[i]         = inst.mem_src3;
+    op_src1_val[i]         = inst.src1_val;
+    op_src2_val[i]         = inst.src2_val;
+    op_dst_val[i]          = inst.dst_val;
+    op_src_vaddr[i]        = inst.src_vaddr;
+    // the op list has always recorded the memory source address as the destination address too
+    op_dst_vaddr[i]        = inst.src_vaddr;
+    if(inst.dst != REG_NUL){
+        reg_writer_clock[inst.dst] = clock;
+    }
+    if(inst.writ_flg){
+        flag_writer_clock = clock;
+    }
+}
+op_record_c *op_state_c::get_op_record(uint op_num){
+    return op_view(op_index(op_num));
+}
+op_record_c *op_state_c::op_view(uint i) const{
+    op_record_c *op = op_views + i;
+    if(op_views_filled & (uint64_t(1) << i)){
+        return op;
+    }
+    op_views_filled |= uint64_t(1) << i;
+    uint flags = op_flags[i];
+    op->clock_time_set   = op_clock_time_set[i];
+    op->src1_val         = op_src1_val[i];
+    op->src2_val         = op_src2_val[i];
+    op->dst_val          = op_dst_val[i];
+    op->src_vaddr        = op_src_vaddr[i];
+    op->dst_vaddr        = op_dst_vaddr[i];
+    op->is_valid         = (flags & OP_IS_VALID) != 0;
+    op->op_class         = op_class_list[i];
+    op->instruction_addr = op_instruction_addr[i];
+    op->is_load          = (flags & OP_IS_LOAD) != 0;
+    op->is_store         = (flags & OP_IS_STORE) != 0;
+    op->is_branch        = (flags & OP_IS_BRANCH) != 0;
+    op->is_op            = (flags & OP_IS_OP) != 0;
+    op->is_fp            = (flags & OP_IS_FP) != 0;
+    op->read_flg         = (flags & OP_READ_FLG) != 0;
+    op->writ_flg         = (flags & OP_WRIT_FLG) != 0;
+    op->src1             = op_src1[i];
+    op->src2             = op_src2[i];
+    op->dst              = op_dst[i];
+    op->has_mem_src      = (flags & OP_HAS_MEM_SRC) != 0;
+    op->has_mem_dst      = (flags & OP_HAS_MEM_DST) != 0;
+    op->special_esc      = false;
+    op->mem_src1         = op_mem_src1[i];
+    op->mem_src2         = op_mem_src2[i];
+    op->mem_src3         = op_mem_src3[i];
+    return op;
+}
 const char* op_state_c::register_name(uint register_code){
     switch(register_code){
         //general purpose registers
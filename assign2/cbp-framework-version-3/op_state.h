@@ -7,6 +7,8 @@
 #define OP_STATE_H_SEEN
 
 #include <cassert>
+#include <inttypes.h>
+#include "cbp_inst.h"
 
 typedef unsigned int uint;
 
@@ -59,8 +61,12 @@ const uint g_num_ops    = 64;
 
 class op_state_c;
 
+// op_record_c is a snapshot of one op in op_state_c's op list.  op_state_c stores the op list
+// field by field, and get_op_record() fills in an op_record_c when it is asked for one; the
+// get_op_* methods of op_state_c read single fields without it.
 class op_record_c
 {
+    friend class op_state_c;
     // when was the latest time that the values were set
     uint clock_time_set;
     // src and dst values
@@ -81,22 +87,22 @@ public:
 
     // Are the values contained in the record available and can they be inspected.  This should be called
     // before trying to look at the data values.
-    bool are_values_available();
+    bool are_values_available() const;
     // set/get the value for src1 
     void set_src1_val(uint new_src1_val);
-    uint get_src1_val();
+    uint get_src1_val() const;
     // set/get the value for src2 
     void set_src2_val(uint new_src2_val);
-    uint get_src2_val();
+    uint get_src2_val() const;
      // set/get the value for dst
     void set_dst_val(uint new_dst_val);
-    uint get_dst_val();
+    uint get_dst_val() const;
     // set/get the address for a memory source 
     void set_src_vaddr(uint new_src_vaddr);
-    uint get_src_vaddr();
+    uint get_src_vaddr() const;
     // set/get the address for a memory dest
     void set_dst_vaddr(uint new_dst_vaddr);
-    uint get_dst_vaddr();
+    uint get_dst_vaddr() const;
     // is this a valid record containing arch state uploaded from a trace
     bool is_valid;
 
@@ -143,20 +149,110 @@ public:
 class op_state_c{
 private:
     int clock;
+
+    // The op list is a ring of g_num_ops entries stored one array per field, so that retiring an
+    // op touches only the fields it writes.  The ring size is a power of two and is indexed with
+    // op_mask.
+    static const uint OP_IS_VALID    = 0x001;
+    static const uint OP_IS_LOAD     = 0x002;
+    static const uint OP_IS_STORE    = 0x004;
+    static const uint OP_IS_BRANCH   = 0x008;
+    static const uint OP_IS_OP       = 0x010;
+    static const uint OP_IS_FP       = 0x020;
+    static const uint OP_READ_FLG    = 0x040;
+    static const uint OP_WRIT_FLG    = 0x080;
+    static const uint OP_HAS_MEM_SRC = 0x100;
+    static const uint OP_HAS_MEM_DST = 0x200;
+    uint op_mask;
+    uint     op_clock_time_set[g_num_ops];
+    uint     op_instruction_addr[g_num_ops];
+    uint     op_src1_val[g_num_ops];
+    uint     op_src2_val[g_num_ops];
+    uint     op_dst_val[g_num_ops];
+    uint     op_src_vaddr[g_num_ops];
+    uint     op_dst_vaddr[g_num_ops];
+    uint16_t op_flags[g_num_ops];
+    uint8_t  op_class_list[g_num_ops];
+    uint8_t  op_src1[g_num_ops];
+    uint8_t  op_src2[g_num_ops];
+    uint8_t  op_dst[g_num_ops];
+    uint8_t  op_mem_src1[g_num_ops];
+    uint8_t  op_mem_src2[g_num_ops];
+    uint8_t  op_mem_src3[g_num_ops];
+    // op_records handed out by get_op_record, one per ring entry; bit i of op_views_filled is
+    // set once op_views[i] holds the op now at ring entry i, so it's filled once per op
+    mutable op_record_c op_views[g_num_ops];
+    mutable uint64_t op_views_filled;
+    static_assert(g_num_ops <= 64, "op_views_filled has a bit per ring entry");
+    op_record_c *op_view(uint index) const;
+
+    // the register file: the value in the low 32 bits and the valid bit above it
+    static const uint64_t REG_VALID = (uint64_t(1) << 32);
+    uint64_t reg_state[g_num_regs];
+
+    // dataflow index: the clock at which the most recent op writing each register (and the
+    // most recent op writing the condition flags) was inserted, or 0 if there hasn't been one
+    uint reg_writer_clock[g_num_regs];
+    uint flag_writer_clock;
+    // op_num of the op inserted at writer_clock, or -1 if it has left the op list
+    int writer_op_num(uint writer_clock) const {
+        uint age = clock - writer_clock;
+        return (writer_clock != 0 && age < num_ops) ? int(age) : -1;
+    }
+    uint op_index(uint op_num) const {
+        assert(op_num < num_ops);
+        return (op_list_ptr - op_num) & op_mask;
+    }
+    bool op_flag(uint op_num, uint flag) const {
+        return (op_flags[op_index(op_num)] & flag) != 0;
+    }
+    // the index of an op whose values the caller reads; like op_record_c's getters, it's an
+    // error to read them before they are visible
+    uint op_value_index(uint op_num) const {
+        assert(are_op_values_available(op_num));
+        return op_index(op_num);
+    }
+
+    // not implemented; the compatibility members below point back at the op_state_c
+    op_state_c(const op_state_c&);
+    op_state_c& operator=(const op_state_c&);
 public:
-    // array indicating which regs are valid
-    bool *regs_valid;
-    // regs: register file of data values visible to the branch predictor
-    uint *regs;
+    // Compatibility with predictors written for the original framework, which read the register
+    // file and the op list through public arrays: regs[r], regs_valid[r] and op_list[i] read what
+    // they did then.  op_list[i] is ring entry i, as it was; new code should use get_op_record
+    // or the get_op_* methods, which take an op_num.
+    class regs_c
+    {
+        const op_state_c *os;
+    public:
+        explicit regs_c(const op_state_c *os_arg) : os(os_arg) {}
+        uint operator[](uint reg_num) const { return os->get_reg_state(reg_num); }
+    };
+    class regs_valid_c
+    {
+        const op_state_c *os;
+    public:
+        explicit regs_valid_c(const op_state_c *os_arg) : os(os_arg) {}
+        bool operator[](uint reg_num) const { return os->is_reg_valid(reg_num); }
+    };
+    class op_list_c
+    {
+        const op_state_c *os;
+    public:
+        explicit op_list_c(const op_state_c *os_arg) : os(os_arg) {}
+        const op_record_c &operator[](uint index) const { return *os->op_view(index & os->op_mask); }
+    };
+    const regs_c regs;
+    const regs_valid_c regs_valid;
+    const op_list_c op_list;
+
     // number of regs in the register file
     uint num_regs;
     // the delay before an instructions result becomes visible to the branch predictor
     uint inst_delay;
     // number of ops contained in the op_list
     uint num_ops;
-    // the op_list contains all ops that produce data values not yet visible to the branch predictor
-    op_record_c *op_list;
-    // pointer to the oldest op in the op list 
+    // index of the most recent op in the op list
     uint op_list_ptr;
 
     op_state_c();
@@ -164,32 +260,79 @@ public:
     void init(op_state_c *new_osptr);
     const char *register_name(uint register_code);
     // clock methods
-    uint get_clock(){
+    uint get_clock() const {
         return clock;
     }
     void inc_clock(){
         clock++;
-        op_list_ptr = (op_list_ptr + 1) % inst_delay;
+        op_list_ptr = (op_list_ptr + 1) & op_mask;
     }
+    // insert_op: advances the clock, commits the destination of the op that falls out of the
+    // op list into the register file, and records inst as the most recent op.  Used by the
+    // trace reader.
+    void insert_op(const cbp::CBP_INST &inst);
     // op state method:
     // is_reg_valid: use this method for checking to see if a register has had a valid result
     // written into it.  Regnum can be any number from 0 - 255 since there are 256 registers.
-    bool is_reg_valid(uint reg_num){
-        return regs_valid[reg_num];
+    bool is_reg_valid(uint reg_num) const {
+        return (reg_state[reg_num] & REG_VALID) != 0;
     }
     // get_reg_state:  use this method for getting values that are stored in a register file entry.
     // It is wise to check that the values are valid before using them.  Some register file entries
     // may never be written to over the course of a trace's execution.
-    uint get_reg_state(uint reg_num){
-        return regs[reg_num];
+    uint get_reg_state(uint reg_num) const {
+        return uint(reg_state[reg_num]);
     }
     // get_op_record: use this method to get the op_record.  op_num = 0 is the most recent op_record.
-    // op_num = 63 is the oldest.
-    op_record_c *get_op_record(uint op_num){
-        uint index  = (op_list_ptr - op_num) % inst_delay;
-        assert(op_num < num_ops);
-        return op_list + index;
+    // op_num = 63 is the oldest.  The record stays valid until the op it describes leaves the op
+    // list.  Filling it in copies every field of the op, so to read only a few of them, use the
+    // get_op_* methods below.
+    op_record_c *get_op_record(uint op_num);
+
+    // dataflow methods:
+    // get_reg_producer: returns the op_num of the most recent op in the op list that writes reg_num,
+    // or -1 if no op in the op list writes it (the register file then holds the latest value).
+    int get_reg_producer(uint reg_num) const {
+        return writer_op_num(reg_writer_clock[reg_num]);
+    }
+    // get_flag_producer: the same for the most recent op that writes the condition flags.
+    int get_flag_producer() const {
+        return writer_op_num(flag_writer_clock);
+    }
+    // these give details of the op at op_num without filling in a whole op_record_c
+    uint get_op_instruction_addr(uint op_num) const {
+        return op_instruction_addr[op_index(op_num)];
+    }
+    uint get_op_class(uint op_num) const {
+        return op_class_list[op_index(op_num)];
+    }
+    // are_op_values_available: the same test as op_record_c::are_values_available
+    bool are_op_values_available(uint op_num) const {
+        return op_clock_time_set[op_index(op_num)] + inst_delay <= get_clock();
     }
+    // the rest of op_record_c's fields, one at a time; the values and addresses, like
+    // op_record_c's getters, may only be read once are_op_values_available says so
+    bool get_op_is_valid(uint op_num) const       { return op_flag(op_num, OP_IS_VALID); }
+    bool get_op_is_load(uint op_num) const        { return op_flag(op_num, OP_IS_LOAD); }
+    bool get_op_is_store(uint op_num) const       { return op_flag(op_num, OP_IS_STORE); }
+    bool get_op_is_branch(uint op_num) const      { return op_flag(op_num, OP_IS_BRANCH); }
+    bool get_op_is_op(uint op_num) const          { return op_flag(op_num, OP_IS_OP); }
+    bool get_op_is_fp(uint op_num) const          { return op_flag(op_num, OP_IS_FP); }
+    bool get_op_read_flg(uint op_num) const       { return op_flag(op_num, OP_READ_FLG); }
+    bool get_op_writ_flg(uint op_num) const       { return op_flag(op_num, OP_WRIT_FLG); }
+    bool get_op_has_mem_src(uint op_num) const    { return op_flag(op_num, OP_HAS_MEM_SRC); }
+    bool get_op_has_mem_dst(uint op_num) const    { return op_flag(op_num, OP_HAS_MEM_DST); }
+    uint get_op_src1(uint op_num) const           { return op_src1[op_index(op_num)]; }
+    uint get_op_src2(uint op_num) const           { return op_src2[op_index(op_num)]; }
+    uint get_op_dst(uint op_num) const            { return op_dst[op_index(op_num)]; }
+    uint get_op_mem_src1(uint op_num) const       { return op_mem_src1[op_index(op_num)]; }
+    uint get_op_mem_src2(uint op_num) const       { return op_mem_src2[op_index(op_num)]; }
+    uint get_op_mem_src3(uint op_num) const       { return op_mem_src3[op_index(op_num)]; }
+    uint get_op_src1_val(uint op_num) const       { return op_src1_val[op_value_index(op_num)]; }
+    uint get_op_src2_val(uint op_num) const       { return op_src2_val[op_value_index(op_num)]; }
+    uint get_op_dst_val(uint op_num) const        { return op_dst_val[op_value_index(op_num)]; }
+    uint get_op_src_vaddr(uint op_num) const      { return op_src_vaddr[op_value_index(op_num)]; }
+    uint get_op_dst_vaddr(uint op_num) const      { return op_dst_vaddr[op_value_index(op_num)]; }
 };
 
 #endif // OP_STATE_H_SEEN
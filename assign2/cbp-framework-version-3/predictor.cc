@@ -1,5 +1,5 @@
 /* Author: Jared Stark;   Created: Tue Jul 27 13:39:15 PDT 2004
- * Description: This file defines a gshare branch predictor.
+ * Description: This file defines the neural (genann MLP) branch predictor.
 */
 
 #include "predictor.h"
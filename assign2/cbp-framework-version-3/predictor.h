@@ -1,5 +1,7 @@
 /* Author: Jared Stark;   Created: Tue Jul 27 13:39:15 PDT 2004
- * Description: This file defines a gshare branch predictor.
+ * Description: This file defines the neural (genann MLP) branch predictor, which
+ * takes the global and path history and the counters of a ghel predictor as its
+ * inputs.
 */
 
 #ifndef PREDICTOR_H_SEEN
@@ -10,119 +12,121 @@
 #include <cstddef>
 #include <inttypes.h>
 #include <vector>
-#include "op_state.h"   // defines op_state_c (architectural state) class 
+#include "op_state.h"   // defines op_state_c (architectural state) class
 #include "tread.h"      // defines branch_record_c class
-#include "genann.h"
+#include "genann_net.h"
+#include "ghel.h"
+#include "predictor_base.h"
+#include "predictor_params.h"
 
-class PREDICTOR
+// The geometry (table size and count, and the history lengths fed to the neural net) is a set of
+// template parameters, so pht_index and the table loops are compiled for constant widths and
+// bounds.  The rest of predictor_params_c is read at run time.  PREDICTOR is the geometry the
+// framework's results were made with; predictor_matrix.h lists the others built into the binary.
+template <int PHT_LENGTH_T, int PHT_COUNT_T, int BHR_LENGTH_NN_T, int PAHIS_LENGTH_T>
+class PREDICTOR_T final : public predictor_base_c
 {
   public:
     typedef uint32_t address_t;
 
   private:
-    typedef uint32_t history_t;
-    typedef int8_t counter_t;
-    typedef unsigned __int128 uint128_t;
-
-    static const int BHR_LENGTH = 64;  // 64 bits
-    static const int BHR_LENGTH_NN = 64;  // 64 bits for neural net
-    static const uint64_t BHR_MASK = (BHR_LENGTH_NN!=64)?((uint64_t(1) << BHR_LENGTH_NN) - 1):(-1); 
-    static const int PAHIS_LENGTH = 16; // 16 bits
-    static const int PHT_LENGTH = 11;   // 2^11 size pht table
-    static const int PHT_COUNT = 8;    // 8 tables
+    typedef GHEL_PREDICTOR_T<PHT_LENGTH_T, PHT_COUNT_T> ghel_t;
+    typedef typename ghel_t::counter_t counter_t;
+
+    static const int BHR_LENGTH_NN = BHR_LENGTH_NN_T;  // bits for neural net
+    static const uint64_t BHR_MASK = (BHR_LENGTH_NN!=64)?((uint64_t(1) << BHR_LENGTH_NN) - 1):(-1);
+    static const int PAHIS_LENGTH = PAHIS_LENGTH_T;
+    static const int PHT_COUNT = PHT_COUNT_T;
     static const std::size_t INPUT_LENGTH = BHR_LENGTH_NN + PAHIS_LENGTH + PHT_COUNT + 1 + 1; // bias and ghel output bit
-    static const std::size_t PHT_SIZE = (std::size_t(1) << PHT_LENGTH);
-    static const counter_t TC_LENGTH = 4;  // 4 bits
-    static const uint32_t TIMES = 2;
-
-    double training_data_input[INPUT_LENGTH];
-    genann *ann;
-    bool predict_nn;
-    bool prediction = false;
-    float prediction_value = 4;
-    
-    uint128_t bhr;  // branch history register
-    history_t pahis;  // path history register
-    counter_t tc; // threshold counter
-    uint32_t theta; //threshold
-    std::vector<counter_t> phts[PHT_COUNT];   // 64K bits
-
-    void update_bhr(bool taken) { bhr <<= 1; if (taken) bhr |= 1; }
-    void update_pahis(address_t pc) { pahis <<= 1; pahis |= pc & 1; }
-    static std::size_t pht_index(address_t pc, uint128_t bhr, history_t pahis, int pht_num) {
-      std::size_t PHT_MASK = (size_t(1) << PHT_LENGTH)-1;
-      if(pht_num == 0) {
-        return static_cast<std::size_t>(pc & PHT_MASK);
-      }
-      uint32_t bhrBitCount = (pht_num==0 ? 0 : (uint32_t(1) << (pht_num-1)));
-      uint32_t pahisBitCount = std::min(uint32_t(16), bhrBitCount);
-      uint64_t append = pahis & ((1 << pahisBitCount) - 1);
-      append |= ((bhr & ((1 << bhrBitCount) - 1))  << pahisBitCount);
-      append |= (uint128_t(pc) << (bhrBitCount + pahisBitCount));
-
-      std::size_t ret = append & PHT_MASK;
-      append >>= PHT_LENGTH;
-      ret ^= (append & PHT_MASK);
-      append >>= PHT_LENGTH;
-      ret ^= (append & PHT_MASK);
-      return ret;
-    }
-    static bool counter_msb(counter_t cnt) { return (cnt >= 0); }
-    static counter_t counter_inc(counter_t cnt)
-        { if (cnt != 7) ++cnt; return cnt; }
-    static counter_t counter_dec(counter_t cnt)
-        { if (cnt != -8) --cnt; return cnt; }
-    void tc_inc(){
-      if (tc != ((counter_t(1) << (TC_LENGTH-1)) - 1))
-        ++tc;
-      else {
-        tc= 0;
-        ++theta;
-      }
-      return;
-    }
-    void tc_dec(){
-      if (tc != (counter_t(1) << (TC_LENGTH-1)))
-        --tc;
-      else {
-        tc= 0;
-        --theta;
-      }
-      return;
-    }
-    void fill_input(address_t pc){
-        uint64_t masked_bhr = bhr & BHR_MASK;
-        for (int i = 0; i < BHR_LENGTH_NN; ++i)
-        {
-            training_data_input[i] = double(masked_bhr & 1);
-            masked_bhr >>= 1;
-        }
-        uint32_t temp_pahis = pahis;
-        for (int i = 0; i < PAHIS_LENGTH; ++i)
-        {
-            training_data_input[BHR_LENGTH_NN + i] = double(temp_pahis & 1);
-            temp_pahis >>= 1;
-        }
+    // the history bits are 0/1 inputs, which are handed to the neural net as a bit vector, and
+    // the rest are dense
+    static const int BINARY_INPUTS = BHR_LENGTH_NN + PAHIS_LENGTH;
+    static const std::size_t DENSE_LENGTH = INPUT_LENGTH - BINARY_INPUTS;
+
+    // the parameters that aren't part of the geometry (see predictor_params.h)
+    const predictor_params_c params;
+    const uint32_t TIMES;
+
+    ghel_t ghel;
+    uint64_t input_bits[2];                // global history, then path history
+    double input_dense[DENSE_LENGTH];      // the ghel counters, the ghel prediction and the bias
+    genann_net_c *ann;                     // in the number format params.nn_bits picks
+    bool predict_nn = false;
+    // the neural net still holds the activations get_prediction computed, so the first training
+    // step can start from them
+    bool have_activations = false;
+
+    void fill_input(){
+        typedef typename ghel_t::uint128_t uint128_t;
+        uint128_t bits = ghel.get_bhr() & BHR_MASK;
+        bits |= uint128_t(ghel.get_pahis() & ((uint64_t(1) << PAHIS_LENGTH) - 1)) << BHR_LENGTH_NN;
+        input_bits[0] = uint64_t(bits);
+        input_bits[1] = uint64_t(bits >> 64);
         for (int i = 0; i < PHT_COUNT; ++i)
         {
-            std::size_t index = pht_index(pc, bhr, pahis, i);
-            counter_t cnt = phts[i][index];//bias
-            training_data_input[i + BHR_LENGTH_NN + PAHIS_LENGTH] = 2*(double(cnt) + 0.5);
+            counter_t cnt = ghel.get_counter(i);//bias
+            input_dense[i] = 2*(double(cnt) + 0.5);
         }
-        training_data_input[INPUT_LENGTH-1]= double(1);
+        input_dense[DENSE_LENGTH-1]= double(1);
     }
 
   public:
- PREDICTOR(void) : bhr(0), pahis(0), theta(PHT_COUNT/2) {
-      std::vector<counter_t> init(PHT_SIZE, 4);
-      for(int i=0; i<PHT_COUNT; ++i) {
-        phts[i] = init;
-      }
-      ann = genann_init(INPUT_LENGTH, 1, 7, 1);
+    // This predictor never looks at op_state, so the trace reader doesn't need to
+    // maintain it (see cbp_reader_config_c::maintain_op_state in tread.h).
+    static const bool USES_OP_STATE = false;
+    static const unsigned PARAMS = predictor_params_c::ALL_PARAMS;
+
+    // the geometry fields of params_arg are replaced by the template's
+ PREDICTOR_T(const predictor_params_c &params_arg = predictor_params_c())
+      : params(with_geometry(params_arg)),
+        TIMES(params.times),
+        ghel(params) {
+      ann = genann_net_c::create(params.nn_bits, INPUT_LENGTH, params.hidden_layers, params.hidden, 1,
+                                 uint32_t(params.seed));
+    }
+    ~PREDICTOR_T() { delete ann; }
+
+    static predictor_params_c with_geometry(predictor_params_c p) {
+      p = ghel_t::with_geometry(p);
+      p.bhr_length_nn = BHR_LENGTH_NN;
+      p.pahis_length  = PAHIS_LENGTH;
+      p.reported      = PARAMS;
+      return p;
+    }
+    const predictor_params_c &get_params() const { return params; }
+
+    // the bits of state the predictor keeps: the ghel predictor's, the path history it
+    // doesn't hash, and each neural net weight
+    uint64_t state_bits() const {
+      return ghel.state_bits() + std::max(0, int(PAHIS_LENGTH) - 16) + uint64_t(ann->total_weights()) * ann->weight_bits();
+    }
+
+    // the ghel predictor's state, then the shape and weights of the neural net; the weights are
+    // saved as doubles whatever nn_bits is, so they can be loaded into a net of any precision
+    void save_state(checkpoint_writer_c* out) const {
+      ghel.save_state(out);
+      out->write_value(int32_t(BHR_LENGTH_NN));
+      out->write_value(int32_t(PAHIS_LENGTH));
+      out->write_value(int32_t(params.hidden_layers));
+      out->write_value(int32_t(params.hidden));
+      out->write_value(int32_t(ann->total_weights()));
+      std::vector<double> weights(ann->total_weights());
+      ann->get_weights(weights.data());
+      out->write(weights.data(), sizeof(double) * weights.size());
+    }
+    bool load_state(checkpoint_reader_c* in) {
+      std::vector<double> weights(ann->total_weights());
+      if (!ghel.load_state(in) ||
+          !in->expect(int32_t(BHR_LENGTH_NN), "bhr_length_nn") ||
+          !in->expect(int32_t(PAHIS_LENGTH), "pahis_length") ||
+          !in->expect(int32_t(params.hidden_layers), "hidden_layers") ||
+          !in->expect(int32_t(params.hidden), "hidden") ||
+          !in->expect(int32_t(ann->total_weights()), "neural net") ||
+          !in->read(weights.data(), sizeof(double) * weights.size()))
+        return false;
+      ann->set_weights(weights.data());
+      return true;
     }
-    // uses compiler generated copy constructor
-    // uses compiler generated destructor
-    // uses compiler generated assignment operator
 
     // get_prediction() takes a branch record (br, branch_record_c is defined in
     // tread.h) and architectural state (os, op_state_c is defined op_state.h).
@@ -131,23 +135,15 @@ class PREDICTOR
     // conditional branches.
     bool get_prediction(const branch_record_c* br, const op_state_c* os)
         {
-            prediction = false;
             if (/* conditional branch */ br->is_conditional) {
               address_t pc = br->instruction_addr;
-              prediction_value = 4; // weekly taken bias
-              for(int i=0; i<PHT_COUNT; ++i){
-                std::size_t index = pht_index(pc, bhr, pahis, i);
-                counter_t cnt = phts[i][index];
-                prediction_value += cnt;
-              }
-              prediction = (prediction_value >= 0 ? true : false);
-              training_data_input[INPUT_LENGTH-2] = (double(prediction) - 0.5)*10;
-              fill_input(pc);
-              predict_nn = (*genann_run(ann, training_data_input) >= 0.5)? 1:0;
-              // std::cout<< *genann_run(ann, training_data_input) << std::endl;
+              bool prediction = ghel.predict(pc);
+              input_dense[DENSE_LENGTH-2] = (double(prediction) - 0.5)*10;
+              fill_input();
+              predict_nn = (ann->run_sparse(input_bits, BINARY_INPUTS, input_dense) >= 0.5)? 1:0;
+              have_activations = true;
             }
-            // return prediction;   // true for taken, false for not taken
-            return predict_nn;
+            return predict_nn;   // true for taken, false for not taken
         }
 
     // Update the predictor after a prediction has been made.  This should accept
@@ -157,35 +153,20 @@ class PREDICTOR
         {
                 address_t pc = br->instruction_addr;
           if (/* conditional branch */ br->is_conditional) {
-                if(prediction != taken || abs(prediction_value) < theta) {
-                  for(int i=0; i<PHT_COUNT; ++i){
-                    std::size_t index = pht_index(pc, bhr, pahis, i);
-                    counter_t cnt = phts[i][index];
-                    if (taken)
-                      cnt = counter_inc(cnt);
-                    else
-                      cnt = counter_dec(cnt);
-                    phts[i][index] = cnt;
-                  }
-                }
-                if(prediction != taken) {
-                  tc_inc();
-                } else if (abs(prediction_value) <= theta) {
-                  tc_dec();
-                }
-                training_data_input[INPUT_LENGTH-2] = (double(prediction) - 0.5)*10;
-                for (int i = 0; i < TIMES; i++) {
-                    double output[1];
-                    output[0] = taken;
-                    genann_train(ann, training_data_input, output, 0.0005);
-                }
-                update_bhr(taken);
-                update_pahis(pc);
+                ghel.train(pc, taken);
+                input_dense[DENSE_LENGTH-2] = (double(ghel.get_last_prediction()) - 0.5)*10;
+                double output[1];
+                output[0] = taken;
+                ann->train_sparse_steps(input_bits, BINARY_INPUTS, input_dense, output, params.learning_rate,
+                                        TIMES, have_activations);
+                have_activations = false;
+                ghel.update_history(pc, taken);
           } else if (br->is_return || br->is_call) {
-            update_bhr(true);
-            update_pahis(pc);
+            ghel.update_history(pc, true);
           }
         }
 };
 
-#endif // PREDICTOR_H_SEEN
\ No newline at end of file
+typedef PREDICTOR_T<11, 8, 64, 16> PREDICTOR;
+
+#endif // PREDICTOR_H_SEEN
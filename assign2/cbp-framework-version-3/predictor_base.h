@@ -0,0 +1,46 @@
+/* Description: This file defines predictor_base_c, the interface of the
+ * predictors built into the driver; predictor_registry.h picks one by name.
+*/
+
+#ifndef PREDICTOR_BASE_H_SEEN
+#define PREDICTOR_BASE_H_SEEN
+
+#include <inttypes.h>
+#include "op_state.h"   // defines op_state_c (architectural state) class
+#include "tread.h"      // defines branch_record_c class
+#include "checkpoint.h"
+#include "predictor_params.h"
+
+// Besides these methods, a predictor has a constructor taking a predictor_params_c, a static
+// with_geometry() that returns the parameters it would report if built with the ones it's given,
+// and declares "static const bool USES_OP_STATE" (see README) and "static const unsigned PARAMS",
+// the predictor_params_c bits of the parameters it takes.  The driver's loops are templates over the
+// predictor's class, and the predictors are declared final, so the calls in those loops are direct
+// and can be inlined; only code holding a predictor_base_c* pays for a virtual call.
+class predictor_base_c
+{
+private:
+    // not implemented
+    predictor_base_c(const predictor_base_c&);
+    predictor_base_c& operator=(const predictor_base_c&);
+public:
+    predictor_base_c() {}
+    virtual ~predictor_base_c() {}
+
+    virtual bool get_prediction(const branch_record_c* br, const op_state_c* os) = 0;
+    virtual void update_predictor(const branch_record_c* br, const op_state_c* os, bool taken) = 0;
+
+    // the parameters the predictor was built with, with any it doesn't support replaced by what
+    // it actually uses, and only those it uses reported
+    virtual const predictor_params_c &get_params() const = 0;
+    // the bits of state the predictor keeps
+    virtual uint64_t state_bits() const = 0;
+
+    // write the state the predictor has learned to a checkpoint, and read it back into a
+    // predictor built with the same geometry; load_state returns false if the checkpoint
+    // doesn't fit (see checkpoint.h)
+    virtual void save_state(checkpoint_writer_c* out) const = 0;
+    virtual bool load_state(checkpoint_reader_c* in) = 0;
+};
+
+#endif // PREDICTOR_BASE_H_SEEN
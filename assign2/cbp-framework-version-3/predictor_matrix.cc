@@ -0,0 +1,52 @@
+/* Description: This file instantiates PREDICTOR_T and GHEL_PREDICTOR_T for every
+ * geometry in PREDICTOR_MATRIX and GHEL_MATRIX, and defines the table used to
+ * pick one; see predictor_matrix.h.
+*/
+
+#include "predictor_matrix.h"
+#include <cstring>
+
+#define PREDICTOR_MATRIX_INSTANTIATE(l, c, b, p) template class PREDICTOR_T<l, c, b, p>;
+PREDICTOR_MATRIX(PREDICTOR_MATRIX_INSTANTIATE)
+#undef PREDICTOR_MATRIX_INSTANTIATE
+#define GHEL_MATRIX_INSTANTIATE(l, c) template class GHEL_PREDICTOR_T<l, c>;
+GHEL_MATRIX(GHEL_MATRIX_INSTANTIATE)
+#undef GHEL_MATRIX_INSTANTIATE
+
+#define PREDICTOR_MATRIX_ENTRY(l, c, b, p) { "pht" #l "x" #c "-bhr" #b "-pa" #p, l, c, b, p },
+const predictor_geometry_c predictor_geometries[] = {
+    PREDICTOR_MATRIX(PREDICTOR_MATRIX_ENTRY)
+};
+#undef PREDICTOR_MATRIX_ENTRY
+const size_t num_predictor_geometries = sizeof(predictor_geometries) / sizeof(predictor_geometries[0]);
+
+const predictor_geometry_c *find_predictor_geometry(const predictor_params_c &params){
+    for(size_t i = 0; i < num_predictor_geometries; i++){
+        const predictor_geometry_c &g = predictor_geometries[i];
+        if(g.pht_length == params.pht_length && g.pht_count == params.pht_count &&
+           g.bhr_length_nn == params.bhr_length_nn && g.pahis_length == params.pahis_length){
+            return &g;
+        }
+    }
+    return 0;
+}
+
+bool set_predictor_geometry(const char *name, predictor_params_c *params){
+    for(size_t i = 0; i < num_predictor_geometries; i++){
+        const predictor_geometry_c &g = predictor_geometries[i];
+        if(0 == strcmp(g.name, name)){
+            params->pht_length    = g.pht_length;
+            params->pht_count     = g.pht_count;
+            params->bhr_length_nn = g.bhr_length_nn;
+            params->pahis_length  = g.pahis_length;
+            return true;
+        }
+    }
+    return false;
+}
+
+void print_predictor_geometries(FILE *out){
+    for(size_t i = 0; i < num_predictor_geometries; i++){
+        fprintf(out, "%s\n", predictor_geometries[i].name);
+    }
+}
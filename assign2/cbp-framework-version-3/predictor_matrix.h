@@ -0,0 +1,105 @@
+/* Description: This file lists the predictor geometries built into the binary
+ * and picks one of them, by name or by its parameters, at startup.  See
+ * predictor_registry.h for picking the predictor itself.
+*/
+
+#ifndef PREDICTOR_MATRIX_H_SEEN
+#define PREDICTOR_MATRIX_H_SEEN
+
+#include <cstdio>
+#include "ghel.h"
+#include "predictor.h"
+#include "predictor_params.h"
+
+// PREDICTOR_MATRIX(X) expands X(pht_length, pht_count, bhr_length_nn, pahis_length) once for
+// each geometry PREDICTOR_T is instantiated for (in predictor_matrix.cc).  A geometry has to be
+// listed here to be run; the first entry is PREDICTOR.
+#define PREDICTOR_MATRIX(X) \
+    X(11, 8, 64, 16) \
+    X( 9, 8, 64, 16) \
+    X(10, 8, 64, 16) \
+    X(12, 8, 64, 16) \
+    X(13, 8, 64, 16) \
+    X(14, 8, 64, 16) \
+    X(10, 4, 64, 16) \
+    X(11, 4, 64, 16) \
+    X(12, 4, 64, 16) \
+    X(11, 6, 64, 16) \
+    X(11, 8, 32, 16) \
+    X(11, 8, 48, 16) \
+    X(11, 8, 64,  8) \
+    X(11, 8, 64, 32)
+
+// GHEL_MATRIX(X) expands X(pht_length, pht_count) for each geometry GHEL_PREDICTOR_T is
+// instantiated for; it has every pair in PREDICTOR_MATRIX, since those predictors contain one.
+#define GHEL_MATRIX(X) \
+    X(11, 8) \
+    X( 9, 8) \
+    X(10, 8) \
+    X(12, 8) \
+    X(13, 8) \
+    X(14, 8) \
+    X(10, 4) \
+    X(11, 4) \
+    X(12, 4) \
+    X(11, 6)
+
+#define PREDICTOR_MATRIX_EXTERN(l, c, b, p) extern template class PREDICTOR_T<l, c, b, p>;
+PREDICTOR_MATRIX(PREDICTOR_MATRIX_EXTERN)
+#undef PREDICTOR_MATRIX_EXTERN
+#define GHEL_MATRIX_EXTERN(l, c) extern template class GHEL_PREDICTOR_T<l, c>;
+GHEL_MATRIX(GHEL_MATRIX_EXTERN)
+#undef GHEL_MATRIX_EXTERN
+
+// one entry of the matrix; the name is "pht<pht_length>x<pht_count>-bhr<bhr_length_nn>-pa<pahis_length>"
+class predictor_geometry_c
+{
+public:
+    const char *name;
+    int pht_length;
+    int pht_count;
+    int bhr_length_nn;
+    int pahis_length;
+};
+
+extern const predictor_geometry_c predictor_geometries[];
+extern const size_t num_predictor_geometries;
+
+// the entry matching the geometry fields of params, or 0 if it isn't built in
+const predictor_geometry_c *find_predictor_geometry(const predictor_params_c &params);
+// sets the geometry fields of params to those of the named entry; false if there's no such entry
+bool set_predictor_geometry(const char *name, predictor_params_c *params);
+// prints the names of the entries, one per line
+void print_predictor_geometries(FILE *out);
+
+// Calls f with a null pointer to the PREDICTOR_T for params' geometry, so the caller's code is
+// compiled once per geometry (e.g. f is a generic lambda that constructs a P and runs a trace
+// through it).  Returns false, without calling f, if the geometry isn't built in.
+template <class F>
+bool dispatch_predictor_geometry(const predictor_params_c &params, F f)
+{
+#define PREDICTOR_MATRIX_DISPATCH(l, c, b, p) \
+    if (params.pht_length == l && params.pht_count == c && params.bhr_length_nn == b && params.pahis_length == p) { \
+        f(static_cast<PREDICTOR_T<l, c, b, p> *>(0)); \
+        return true; \
+    }
+    PREDICTOR_MATRIX(PREDICTOR_MATRIX_DISPATCH)
+#undef PREDICTOR_MATRIX_DISPATCH
+    return false;
+}
+
+// the same for GHEL_PREDICTOR_T, whose geometry is only pht_length and pht_count
+template <class F>
+bool dispatch_ghel_geometry(const predictor_params_c &params, F f)
+{
+#define GHEL_MATRIX_DISPATCH(l, c) \
+    if (params.pht_length == l && params.pht_count == c) { \
+        f(static_cast<GHEL_PREDICTOR_T<l, c> *>(0)); \
+        return true; \
+    }
+    GHEL_MATRIX(GHEL_MATRIX_DISPATCH)
+#undef GHEL_MATRIX_DISPATCH
+    return false;
+}
+
+#endif // PREDICTOR_MATRIX_H_SEEN
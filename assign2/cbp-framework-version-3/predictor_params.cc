@@ -0,0 +1,194 @@
+/* Description: This file defines predictor_params_c, the geometry and training
+ * parameters of the predictor; see predictor_params.h.
+*/
+
+#include "predictor_params.h"
+#include "genann_net.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+predictor_params_c::predictor_params_c(){
+    pht_length    = 11;
+    pht_count     = 8;
+    bhr_length_nn = 64;
+    pahis_length  = 16;
+    tc_length     = 4;
+    times         = 2;
+    hidden_layers = 1;
+    hidden        = 7;
+    learning_rate = 0.0005;
+    seed          = 1;
+    nn_bits       = 64;
+    reported      = ALL_PARAMS;
+}
+
+static const struct { const char *name; unsigned bit; } param_names[] = {
+    { "pht_length",    predictor_params_c::PHT_LENGTH_PARAM    },
+    { "pht_count",     predictor_params_c::PHT_COUNT_PARAM     },
+    { "bhr_length_nn", predictor_params_c::BHR_LENGTH_NN_PARAM },
+    { "pahis_length",  predictor_params_c::PAHIS_LENGTH_PARAM  },
+    { "tc_length",     predictor_params_c::TC_LENGTH_PARAM     },
+    { "times",         predictor_params_c::TIMES_PARAM         },
+    { "hidden_layers", predictor_params_c::HIDDEN_LAYERS_PARAM },
+    { "hidden",        predictor_params_c::HIDDEN_PARAM        },
+    { "learning_rate", predictor_params_c::LEARNING_RATE_PARAM },
+    { "seed",          predictor_params_c::SEED_PARAM          },
+    { "nn_bits",       predictor_params_c::NN_BITS_PARAM       },
+};
+
+static bool parse_int(const char *value, int *result){
+    char *end;
+    errno = 0;
+    long v = strtol(value, &end, 0);
+    if(errno || end == value || *end || v < -0x7fffffffL || v > 0x7fffffffL){
+        return false;
+    }
+    *result = int(v);
+    return true;
+}
+
+bool predictor_params_c::set(const char *name, const char *value){
+    if(0 == strcmp(name, "learning_rate")){
+        char *end;
+        learning_rate = strtod(value, &end);
+        return end != value && !*end;
+    }
+    struct { const char *name; int *field; } fields[] = {
+        { "pht_length",    &pht_length    },
+        { "pht_count",     &pht_count     },
+        { "bhr_length_nn", &bhr_length_nn },
+        { "pahis_length",  &pahis_length  },
+        { "tc_length",     &tc_length     },
+        { "times",         &times         },
+        { "hidden_layers", &hidden_layers },
+        { "hidden",        &hidden        },
+        { "seed",          &seed          },
+        { "nn_bits",       &nn_bits       },
+    };
+    for(size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++){
+        if(0 == strcmp(name, fields[i].name)){
+            return parse_int(value, fields[i].field);
+        }
+    }
+    return false;
+}
+
+unsigned predictor_params_c::param_bit(const char *name){
+    size_t length = strcspn(name, "=");
+    for(size_t i = 0; i < sizeof(param_names) / sizeof(param_names[0]); i++){
+        if(strlen(param_names[i].name) == length && 0 == strncmp(name, param_names[i].name, length)){
+            return param_names[i].bit;
+        }
+    }
+    return 0;
+}
+
+bool predictor_params_c::set(const char *assignment){
+    const char *equals = strchr(assignment, '=');
+    if(!equals){
+        return false;
+    }
+    string name(assignment, equals - assignment);
+    return set(name.c_str(), equals + 1);
+}
+
+// strips the blanks from both ends of s
+static string trim(const string &s){
+    size_t begin = s.find_first_not_of(" \t\r\n");
+    if(begin == string::npos){
+        return "";
+    }
+    size_t end = s.find_last_not_of(" \t\r\n");
+    return s.substr(begin, end - begin + 1);
+}
+
+bool predictor_params_c::load(const char *path){
+    FILE *file = fopen(path, "r");
+    if(!file){
+        printf("cannot open parameter file %s\n", path);
+        return false;
+    }
+    char buffer[1024];
+    int line_num = 0;
+    bool ok = true;
+    while(ok && fgets(buffer, sizeof(buffer), file)){
+        line_num++;
+        string line(buffer);
+        line = trim(line.substr(0, line.find('#')));
+        if(line.empty()){
+            continue;
+        }
+        size_t equals = line.find('=');
+        if(equals == string::npos || !set(trim(line.substr(0, equals)).c_str(), trim(line.substr(equals + 1)).c_str())){
+            printf("%s:%d: bad parameter: %s\n", path, line_num, line.c_str());
+            ok = false;
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+bool predictor_params_c::check() const{
+    // pht_index hashes at most 64 bits of global history into a table, and a counter
+    // has to hold the range of the threshold counter
+    const char *problem = 0;
+    if(pht_length < 1 || pht_length > 24){
+        problem = "pht_length must be 1..24";
+    }
+    else if(pht_count < 1 || pht_count > 8){
+        problem = "pht_count must be 1..8";
+    }
+    else if(bhr_length_nn < 0 || bhr_length_nn > 64){
+        problem = "bhr_length_nn must be 0..64";
+    }
+    else if(pahis_length < 0 || pahis_length > 32){
+        problem = "pahis_length must be 0..32";
+    }
+    else if(tc_length < 2 || tc_length > 8){
+        problem = "tc_length must be 2..8";
+    }
+    else if(times < 0){
+        problem = "times can't be negative";
+    }
+    else if(hidden_layers < 0 || (hidden_layers > 0 && hidden < 1)){
+        problem = "the neural net needs at least one neuron in each hidden layer";
+    }
+    else if(nn_bits != 64 && nn_bits != 32 && nn_bits != 16){
+        problem = "nn_bits must be 64, 32 or 16";
+    }
+    if(problem){
+        printf("bad predictor parameters: %s\n", problem);
+        return false;
+    }
+    // in fixed point, updates smaller than a weight step are lost, and the net hardly learns
+    if(learning_rate < genann_net_c::min_learning_rate(nn_bits)){
+        printf("bad predictor parameters: learning_rate must be at least %g with nn_bits=%d\n",
+               genann_net_c::min_learning_rate(nn_bits), nn_bits);
+        return false;
+    }
+    return true;
+}
+
+string predictor_params_c::to_string() const{
+    // in the order of param_names; learning_rate is a double
+    int values[] = { pht_length, pht_count, bhr_length_nn, pahis_length, tc_length, times,
+                     hidden_layers, hidden, 0, seed, nn_bits };
+    string result;
+    for(size_t i = 0; i < sizeof(param_names) / sizeof(param_names[0]); i++){
+        if(!(reported & param_names[i].bit)){
+            continue;
+        }
+        char buffer[64];
+        if(param_names[i].bit == LEARNING_RATE_PARAM){
+            snprintf(buffer, sizeof(buffer), "%s=%g", param_names[i].name, learning_rate);
+        }
+        else{
+            snprintf(buffer, sizeof(buffer), "%s=%d", param_names[i].name, values[i]);
+        }
+        result += (result.empty() ? "" : " ") + string(buffer);
+    }
+    return result;
+}
@@ -0,0 +1,62 @@
+/* Description: This file defines predictor_params_c, the geometry and training
+ * parameters of the predictor, which can be set from the command line or read
+ * from a parameter file instead of being compiled in.
+*/
+
+#ifndef PREDICTOR_PARAMS_H_SEEN
+#define PREDICTOR_PARAMS_H_SEEN
+
+#include <cstdio>
+#include <string>
+
+// The defaults are the predictor's original settings.  A parameter file has one "name = value"
+// per line; blank lines and everything after a '#' are ignored.
+class predictor_params_c
+{
+public:
+    predictor_params_c();
+    int pht_length;                // log2 of the entries in each pattern history table
+    int pht_count;                 // pattern history tables
+    int bhr_length_nn;             // global history bits fed to the neural net
+    int pahis_length;              // path history bits fed to the neural net
+    int tc_length;                 // bits in the threshold counter
+    int times;                     // training steps per conditional branch
+    int hidden_layers;             // hidden layers in the neural net
+    int hidden;                    // neurons in each hidden layer
+    double learning_rate;
+    int seed;                      // seeds the random initial weights of the neural net
+    int nn_bits;                   // bits per neural net weight: 64 (double), 32 (float) or 16 (fixed point)
+
+    // one bit per parameter, for the sets of them a predictor takes or reports
+    enum {
+        PHT_LENGTH_PARAM    = 1 << 0,
+        PHT_COUNT_PARAM     = 1 << 1,
+        BHR_LENGTH_NN_PARAM = 1 << 2,
+        PAHIS_LENGTH_PARAM  = 1 << 3,
+        TC_LENGTH_PARAM     = 1 << 4,
+        TIMES_PARAM         = 1 << 5,
+        HIDDEN_LAYERS_PARAM = 1 << 6,
+        HIDDEN_PARAM        = 1 << 7,
+        LEARNING_RATE_PARAM = 1 << 8,
+        SEED_PARAM          = 1 << 9,
+        NN_BITS_PARAM       = 1 << 10,
+        ALL_PARAMS          = (1 << 11) - 1
+    };
+    // the parameters to_string() lists; a predictor's get_params() has only those it uses
+    unsigned reported;
+
+    // sets one parameter from its name and value, or from "name=value"; false if either is bad
+    bool set(const char *name, const char *value);
+    bool set(const char *assignment);
+    // the bit of the parameter named by name, or by the name in "name=value"; 0 if there's none
+    static unsigned param_bit(const char *name);
+    // reads a parameter file; prints a message and returns false if it can't
+    bool load(const char *path);
+    // true if the parameters describe a predictor that can be built; otherwise prints why not
+    bool check() const;
+
+    // the reported parameters as "name=value" pairs separated by spaces, in a form set() accepts
+    std::string to_string() const;
+};
+
+#endif // PREDICTOR_PARAMS_H_SEEN
@@ -0,0 +1,38 @@
+/* Description: This file lists the predictors built into the driver and creates
+ * them; see predictor_registry.h.
+*/
+
+#include "predictor_registry.h"
+#include <type_traits>
+
+const predictor_engine_c predictor_engines[] = {
+    { "mlp",    "genann neural net over global and path history and the ghel counters (predictor.h)" },
+    { "ghel",   "sum of hashed counter tables with geometric history lengths (ghel.h)" },
+    { "gshare", "the framework's original 15-bit gshare (gshare.h)" },
+};
+const size_t num_predictor_engines = sizeof(predictor_engines) / sizeof(predictor_engines[0]);
+const char *const DEFAULT_PREDICTOR = "mlp";
+
+const predictor_engine_c *find_predictor_engine(const char *name){
+    for(size_t i = 0; i < num_predictor_engines; i++){
+        if(0 == strcmp(predictor_engines[i].name, name)){
+            return &predictor_engines[i];
+        }
+    }
+    return 0;
+}
+
+void print_predictor_engines(FILE *out){
+    for(size_t i = 0; i < num_predictor_engines; i++){
+        fprintf(out, "%-8s %s\n", predictor_engines[i].name, predictor_engines[i].description);
+    }
+}
+
+predictor_base_c *create_predictor(const char *name, const predictor_params_c &params){
+    predictor_base_c *predictor = 0;
+    dispatch_predictor(name, params, [&](auto *engine) {
+        typedef typename std::remove_pointer<decltype(engine)>::type P;
+        predictor = new P(params);
+    });
+    return predictor;
+}
@@ -0,0 +1,55 @@
+/* Description: This file lists the predictors built into the driver, which are
+ * picked by name with --predictor=NAME, and creates them.
+*/
+
+#ifndef PREDICTOR_REGISTRY_H_SEEN
+#define PREDICTOR_REGISTRY_H_SEEN
+
+#include <cstdio>
+#include <cstring>
+#include "ghel.h"
+#include "gshare.h"
+#include "predictor.h"
+#include "predictor_base.h"
+#include "predictor_matrix.h"
+#include "predictor_params.h"
+
+class predictor_engine_c
+{
+public:
+    const char *name;
+    const char *description;
+};
+
+extern const predictor_engine_c predictor_engines[];
+extern const size_t num_predictor_engines;
+extern const char *const DEFAULT_PREDICTOR;       // the one BASELINE was made with
+
+// the named predictor, or 0 if there's no such predictor
+const predictor_engine_c *find_predictor_engine(const char *name);
+// prints the names and descriptions of the predictors, one per line
+void print_predictor_engines(FILE *out);
+
+// Calls f with a null pointer to the class of the named predictor, built for params' geometry,
+// so the caller's code is compiled for each predictor and calls it directly; see
+// dispatch_predictor_geometry in predictor_matrix.h.  Returns false, without calling f, if there's
+// no such predictor or it isn't built for that geometry.
+template <class F>
+bool dispatch_predictor(const char *name, const predictor_params_c &params, F f)
+{
+    if (0 == strcmp(name, "mlp"))
+        return dispatch_predictor_geometry(params, f);
+    if (0 == strcmp(name, "ghel"))
+        return dispatch_ghel_geometry(params, f);
+    if (0 == strcmp(name, "gshare")) {
+        f(static_cast<GSHARE_PREDICTOR *>(0));
+        return true;
+    }
+    return false;
+}
+
+// the named predictor, built with params, for code that doesn't need direct calls; 0 if
+// dispatch_predictor would return false
+predictor_base_c *create_predictor(const char *name, const predictor_params_c &params);
+
+#endif // PREDICTOR_REGISTRY_H_SEEN
@@ -0,0 +1,102 @@
+/* Description: This file implements a lock-free single-producer,
+ * single-consumer ring buffer for handing items from one thread to another.
+*/
+
+#ifndef SPSC_RING_H_SEEN
+#define SPSC_RING_H_SEEN
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+namespace cbp
+{
+    // Exactly one thread may call push() and exactly one other thread may call
+    // pop().  The producer and consumer indices live on separate cache lines, and
+    // each side keeps a private copy of the other side's index so it only touches
+    // the shared one when the ring looks full (or empty).
+    template <class Type, int LG2_SIZE>
+    class SPSC_RING
+    {
+      private:
+        // not implemented
+        explicit SPSC_RING(const SPSC_RING<Type, LG2_SIZE>&);
+        SPSC_RING<Type, LG2_SIZE>& operator=(const SPSC_RING<Type, LG2_SIZE>&);
+
+        static const std::size_t SIZE = (std::size_t(1) << LG2_SIZE);
+        static const std::size_t MASK = (SIZE - 1);
+        enum { CACHE_LINE = 64 };
+
+        alignas(CACHE_LINE) std::atomic<std::size_t> head;   // next slot to pop; written by the consumer
+        std::size_t tail_cache;                               // consumer's copy of tail
+        alignas(CACHE_LINE) std::atomic<std::size_t> tail;   // next slot to push; written by the producer
+        std::size_t head_cache;                               // producer's copy of head
+        alignas(CACHE_LINE) Type slots[SIZE];
+
+      public:
+        SPSC_RING(void) : head(0), tail_cache(0), tail(0), head_cache(0) { }
+        // uses compiler generated destructor
+
+        // Returns false if the ring is full.
+        bool try_push(const Type& item);
+        // Returns false if the ring is empty.
+        bool try_pop(Type* item);
+
+        // Spin (yielding the processor) until the item is pushed or popped.  The
+        // push gives up and returns false if 'abandon' becomes true.
+        bool push(const Type& item, const std::atomic<bool>& abandon);
+        void pop(Type* item);
+    };
+
+    template <class Type, int LG2_SIZE>
+    inline bool
+    SPSC_RING<Type, LG2_SIZE>::try_push(const Type& item)
+    {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        if ((t - head_cache) == SIZE) {
+            head_cache = head.load(std::memory_order_acquire);
+            if ((t - head_cache) == SIZE)
+                return false;
+        }
+        slots[t & MASK] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <class Type, int LG2_SIZE>
+    inline bool
+    SPSC_RING<Type, LG2_SIZE>::try_pop(Type* item)
+    {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail_cache) {
+            tail_cache = tail.load(std::memory_order_acquire);
+            if (h == tail_cache)
+                return false;
+        }
+        *item = slots[h & MASK];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <class Type, int LG2_SIZE>
+    bool
+    SPSC_RING<Type, LG2_SIZE>::push(const Type& item, const std::atomic<bool>& abandon)
+    {
+        while (!try_push(item)) {
+            if (abandon.load(std::memory_order_relaxed))
+                return false;
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    template <class Type, int LG2_SIZE>
+    void
+    SPSC_RING<Type, LG2_SIZE>::pop(Type* item)
+    {
+        while (!try_pop(item))
+            std::this_thread::yield();
+    }
+} // namespace cbp
+
+#endif // SPSC_RING_H_SEEN
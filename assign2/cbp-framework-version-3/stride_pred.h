@@ -5,6 +5,7 @@
 #ifndef STRIDE_PRED_H_SEEN
 #define STRIDE_PRED_H_SEEN
 
+#include <algorithm>
 #include <cstddef>
 #include <inttypes.h>
 
@@ -33,6 +34,9 @@ namespace cbp
       public:
         STRIDE_PRED(void) { }
         // uses compiler generated destructor
+
+        // returns the predictor to its initial state
+        void reset(void) { std::fill_n(table, SIZE, ENTRY()); }
      
         uint64_t get_prediction(uint64_t vip) const;
         void train(uint64_t vip, uint64_t v);
@@ -0,0 +1,67 @@
+/* Description: This file defines the restart index (.idx) of a segmented CBP
+ * trace; see trace_index.h.
+*/
+
+#include "trace_index.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+const char TRACE_INDEX_MAGIC[8] = { 'C', 'B', 'P', 'I', 'D', 'X', '\n', '\0' };
+
+trace_index_c::trace_index_c(){
+    restart_interval = 0;
+}
+bool trace_index_c::load(const char *path){
+    FILE *file = fopen(path, "rb");
+    if(!file){
+        if(errno == ENOENT){
+            return false;
+        }
+        fprintf(stderr, "cannot open trace index %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    trace_index_header_c header;
+    if(fread(&header, sizeof(header), 1, file) != 1
+       || memcmp(header.magic, TRACE_INDEX_MAGIC, sizeof(TRACE_INDEX_MAGIC)) != 0
+       || header.version != TRACE_INDEX_VERSION
+       || header.restart_interval == 0){
+        fprintf(stderr, "%s is not a version %u trace index; rerun cbpsegment\n", path, TRACE_INDEX_VERSION);
+        exit(EXIT_FAILURE);
+    }
+    restart_interval = header.restart_interval;
+    segments.resize(header.num_segments);
+    if(header.num_segments != 0
+       && fread(&segments[0], sizeof(trace_segment_c), segments.size(), file) != segments.size()){
+        fprintf(stderr, "trace index %s is truncated\n", path);
+        exit(EXIT_FAILURE);
+    }
+    fclose(file);
+    return true;
+}
+void trace_index_c::save(const char *path) const{
+    FILE *file = fopen(path, "wb");
+    if(!file){
+        fprintf(stderr, "cannot create trace index %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    trace_index_header_c header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_INDEX_MAGIC, sizeof(TRACE_INDEX_MAGIC));
+    header.version          = TRACE_INDEX_VERSION;
+    header.restart_interval = restart_interval;
+    header.num_segments     = segments.size();
+    if(fwrite(&header, sizeof(header), 1, file) != 1
+       || (!segments.empty() && fwrite(&segments[0], sizeof(trace_segment_c), segments.size(), file) != segments.size())
+       || fclose(file) != 0){
+        fprintf(stderr, "error writing trace index %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+}
+size_t trace_index_c::find_segment(uint64_t inst) const{
+    size_t segment = size_t(inst / restart_interval);
+    return segment < segments.size() ? segment : segments.size();
+}
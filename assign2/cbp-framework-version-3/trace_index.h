@@ -0,0 +1,59 @@
+/* Description: This file defines the restart index (.idx) of a segmented CBP
+ * trace.  A segmented trace is written by cbpsegment: the CBP_INST stream
+ * resets its adaptive state every restart_interval instructions, and each
+ * segment between two restart points is compressed as its own bzip2 stream.
+ * The index records where each segment starts in the .bz2 file, so a reader
+ * can start decoding at any segment, or decode several segments at once.
+*/
+
+#ifndef TRACE_INDEX_H_SEEN
+#define TRACE_INDEX_H_SEEN
+
+#include <cstddef>
+#include <inttypes.h>
+#include <vector>
+
+class trace_segment_c
+{
+public:
+    uint64_t offset;               // byte offset of the segment's bzip2 stream in the .bz2 file
+    uint64_t num_insts;            // instructions in the segment
+};
+
+// An .idx file is a trace_index_header_c followed by num_segments trace_segment_c's,
+// all in the byte order of the machine that wrote it.
+class trace_index_header_c
+{
+public:
+    char     magic[8];             // TRACE_INDEX_MAGIC
+    uint32_t version;              // TRACE_INDEX_VERSION
+    uint32_t reserved;
+    uint64_t restart_interval;     // instructions between restart points
+    uint64_t num_segments;
+};
+
+extern const char     TRACE_INDEX_MAGIC[8];
+const uint32_t        TRACE_INDEX_VERSION = 1;
+
+class trace_index_c
+{
+public:
+    uint64_t restart_interval;
+    std::vector<trace_segment_c> segments;
+
+    trace_index_c();
+    // uses compiler generated destructor
+
+    // reads 'path'; returns false if there is no such file, and exits with an error message
+    // if it isn't a valid index
+    bool load(const char *path);
+    // writes 'path'; exits with an error message if it can't
+    void save(const char *path) const;
+    // the segment holding instruction 'inst' (the first instruction of the trace is 0), or
+    // segments.size() if the trace is shorter than that
+    std::size_t find_segment(uint64_t inst) const;
+    // the number of the first instruction of segment 'segment'
+    uint64_t segment_start(std::size_t segment) const { return segment * restart_interval; }
+};
+
+#endif // TRACE_INDEX_H_SEEN
@@ -4,9 +4,21 @@
 */
 
 #include "tread.h"
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <condition_variable>
 #include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "branch_profile.h"
+#include "brtrace.h"
+#include "bz2_input.h"
 #include "op_state.h"
+#include "spsc_ring.h"
+#include "trace_index.h"
 
 using namespace cbp;
 using namespace std;
@@ -28,18 +40,273 @@ void branch_record_c::init(){
 void branch_record_c::debug_print(){
     //printf("jp-op(%2x)t(%1x)lip(%8x)tar(%8x)nlip(%8x)num(%8x)\n", jump_class, tkn, lip, tar, nlip, num_insts);
 }
+cbp_reader_config_c::cbp_reader_config_c(){
+    decode_threads    = 0;
+    pipelined         = false;
+    maintain_op_state = true;
+    skip_insts        = 0;
+    stop_insts        = 0;
+    sample_period     = 0;
+    sample_length     = 0;
+    sample_warmup     = 0;
+    print_statistics  = true;
+    profile_interval  = 0;
+    profile_top       = 0;
+}
+
+// copies the branch information in inst into branch_record
+static void set_branch_record(branch_record_c *branch_record, const CBP_INST &inst){
+    branch_record->init();
+    branch_record->instruction_addr      = inst.instruction_addr;
+    branch_record->branch_target         = inst.branch_target;
+    branch_record->instruction_next_addr = inst.instruction_next_addr;
+    branch_record->is_indirect           = inst.is_indirect;
+    branch_record->is_conditional        = inst.is_conditional;
+    branch_record->is_call               = inst.is_call;
+    branch_record->is_return             = inst.is_return;
+}
+
+// one decoded branch passed from the decode thread to the predictor thread
+class cbp_pipe_entry_c
+{
+public:
+    branch_record_c br;
+    bool taken;
+    bool valid;                                     // false marks the end of the trace
+    uint num_insts;                                 // instructions up to and including the branch
+};
+
+// the ring and decode thread used in pipelined mode
+class cbp_branch_pipe_c
+{
+public:
+    cbp::SPSC_RING<cbp_pipe_entry_c, 12> ring;
+    std::atomic<bool> stopping;                     // tells the decode thread to give up early
+    std::thread decoder;
+    bool done;                                      // the predictor thread has seen the end of the trace
+    cbp_branch_pipe_c() : stopping(false), done(false) {}
+};
+
+// one decoded branch of a segment, with the number of instructions since the previous branch
+class cbp_segment_branch_c
+{
+public:
+    branch_record_c br;
+    bool taken;
+    uint num_insts;
+};
+
+// decodes the segments of a segmented trace on a pool of threads; the reader takes their
+// branches in trace order
+class cbp_segment_decoder_c
+{
+private:
+    class segment_c
+    {
+    public:
+        segment_c() : tail_insts(0), done(false) {}
+        std::vector<cbp_segment_branch_c> branches;
+        uint tail_insts;                            // instructions after the segment's last branch
+        bool done;                                  // a worker has finished decoding it
+    };
+    std::string path;
+    const trace_index_c &index;
+    uint64_t skip_insts;                            // instructions to skip at the start of the first segment
+    std::vector<segment_c> segs;
+    std::mutex mutex;
+    std::condition_variable segment_done;           // signalled by workers
+    std::condition_variable segment_taken;          // signalled by the reader
+    std::vector<std::thread> workers;
+    size_t first_segment;
+    size_t next_to_decode;
+    size_t next_to_read;
+    size_t next_branch;                             // next branch of segs[next_to_read]
+    bool have_segment;                              // segs[next_to_read] has been decoded
+    size_t max_ahead;                               // bounds the number of decoded segments held
+    bool stopping;
+
+    void worker();
+    void decode_segment(size_t seg_num, segment_c *seg);
+public:
+    cbp_segment_decoder_c(const std::string &path_arg, const trace_index_c &index_arg, uint64_t start_inst, uint num_threads);
+    ~cbp_segment_decoder_c();
+    // returns the next branch, adding the instructions up to and including it to num_insts;
+    // at the end of the trace, adds the instructions after the last branch and returns false
+    bool next(cbp_segment_branch_c *branch, uint *num_insts);
+};
+
+cbp_segment_decoder_c::cbp_segment_decoder_c(const string &path_arg, const trace_index_c &index_arg, uint64_t start_inst, uint num_threads)
+    : path(path_arg), index(index_arg), segs(index_arg.segments.size()){
+    first_segment  = index.find_segment(start_inst);
+    skip_insts     = first_segment < segs.size() ? start_inst - index.segment_start(first_segment) : 0;
+    next_to_decode = first_segment;
+    next_to_read   = first_segment;
+    next_branch    = 0;
+    have_segment   = false;
+    max_ahead      = 2 * num_threads;
+    stopping       = false;
+    for(uint i = 0; i < num_threads; i++){
+        workers.push_back(std::thread(&cbp_segment_decoder_c::worker, this));
+    }
+}
+cbp_segment_decoder_c::~cbp_segment_decoder_c(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    segment_taken.notify_all();
+    for(size_t i = 0; i < workers.size(); i++){
+        workers[i].join();
+    }
+}
+void cbp_segment_decoder_c::worker(){
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true){
+        while(!stopping && next_to_decode < segs.size() && next_to_decode >= next_to_read + max_ahead){
+            segment_taken.wait(lock);
+        }
+        if(stopping || next_to_decode == segs.size()){
+            return;
+        }
+        size_t seg_num = next_to_decode++;
+        segment_c decoded;
+        lock.unlock();
+        decode_segment(seg_num, &decoded);
+        lock.lock();
+        segs[seg_num].branches.swap(decoded.branches);
+        segs[seg_num].tail_insts = decoded.tail_insts;
+        segs[seg_num].done       = true;
+        segment_done.notify_all();
+    }
+}
+// each segment starts with a fresh CBP_INST_STREAM, which is the state the encoder restarted from
+void cbp_segment_decoder_c::decode_segment(size_t seg_num, segment_c *seg){
+    const trace_segment_c &entry = index.segments[seg_num];
+    CBP_INPUT *input = bz2_input_open_at(path.c_str(), entry.offset);
+    CBP_INST_STREAM *stream = cbp_inst_open(input);
+    uint64_t skip = (seg_num == first_segment) ? skip_insts : 0;
+    CBP_INST inst;
+    uint num_insts = 0;
+    for(uint64_t i = 0; i < entry.num_insts && cbp_inst_read(stream, &inst); i++){
+        if(i < skip){
+            continue;
+        }
+        num_insts++;
+        if(inst.is_branch){
+            cbp_segment_branch_c branch;
+            set_branch_record(&branch.br, inst);
+            branch.taken     = inst.taken;
+            branch.num_insts = num_insts;
+            seg->branches.push_back(branch);
+            num_insts = 0;
+        }
+    }
+    seg->tail_insts = num_insts;
+    cbp_inst_close(stream);
+    delete input;
+}
+bool cbp_segment_decoder_c::next(cbp_segment_branch_c *branch, uint *num_insts){
+    while(next_to_read < segs.size()){
+        segment_c &seg = segs[next_to_read];
+        if(!have_segment){
+            std::unique_lock<std::mutex> lock(mutex);
+            while(!seg.done){
+                segment_done.wait(lock);
+            }
+            have_segment = true;
+        }
+        if(next_branch < seg.branches.size()){
+            *branch     = seg.branches[next_branch++];
+            *num_insts += branch->num_insts;
+            return true;
+        }
+        // the instructions after the segment's last branch belong to the next branch
+        *num_insts += seg.tail_insts;
+        std::vector<cbp_segment_branch_c>().swap(seg.branches);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            next_to_read++;
+        }
+        next_branch  = 0;
+        have_segment = false;
+        segment_taken.notify_all();
+    }
+    return false;
+}
 //predictor apsi.cbp_inst.jz
-cbp_trace_reader_c::cbp_trace_reader_c(char *trace_name){
-    char trace_name_copy[256];
-    char trnm_cmdline[256];
-    memset((char *) trace_name_copy,  0, 256);
-    memset((char *) trnm_cmdline,  0, 256);
+cbp_trace_reader_c::cbp_trace_reader_c(char *trace_name, const cbp_reader_config_c &config){
     // we need the name the name of the trace 
     assert(trace_name);
-    strcpy(trace_name_copy, trace_name);
-    sprintf(trnm_cmdline, "bzip2 -dc %s.bz2", trace_name_copy);
-    from_cbp_trace_file = popen(trnm_cmdline, "r");
-    from_cbp_inst_stream = cbp_inst_open(from_cbp_trace_file);
+    string trace_file_name = string(trace_name);
+    from_cbp_trace_input = 0;
+    from_cbp_inst_stream = 0;
+    from_br_trace        = 0;
+    br_trace_done        = false;
+    br_trace_skip        = 0;
+    pipe                 = 0;
+    segments             = 0;
+    index                = 0;
+    maintain_op_state    = config.maintain_op_state;
+    print_statistics     = config.print_statistics;
+    profile              = 0;
+    branch_insts         = 0;
+    if(config.profile_interval || config.profile_top){
+        profile = new branch_profile_c(config.profile_interval, config.profile_top, config.sample_period,
+                                       config.sample_warmup, config.sample_length);
+    }
+    sample_period        = config.sample_period;
+    sample_length        = config.sample_length;
+    sample_warmup        = config.sample_warmup;
+    branch_interval      = 0;
+    if(sample_period && (sample_length == 0 || sample_warmup + sample_length > sample_period)){
+        fprintf(stderr, "the sample warmup and length must fit in the sample period\n");
+        exit(EXIT_FAILURE);
+    }
+    uint64_t skip_insts  = config.skip_insts;
+    max_insts            = ~uint64_t(0);
+    if(config.stop_insts){
+        max_insts = (config.stop_insts > skip_insts) ? config.stop_insts - skip_insts : 0;
+    }
+    if(trace_file_name.size() > 4 && trace_file_name.compare(trace_file_name.size() - 4, 4, ".brt") == 0){
+        // a .brt holds only the branches, so there's nothing to keep op_state up to date with
+        if(maintain_op_state){
+            fprintf(stderr, "%s: a .brt trace has no op_state; use the original trace with this predictor\n",
+                    trace_name);
+            exit(EXIT_FAILURE);
+        }
+        from_br_trace = new br_trace_file_c(trace_name);
+        br_trace_skip = skip_insts;
+    }
+    else{
+        index = new trace_index_c();
+        if(!index->load((trace_file_name + ".idx").c_str())){
+            delete index;
+            index = 0;
+        }
+        trace_file_name += ".bz2";
+        uint decode_threads = config.decode_threads ? config.decode_threads : std::thread::hardware_concurrency();
+        if(index && !maintain_op_state && decode_threads > 1){
+            // the segments are independent, so without op_state they can be decoded all at once
+            segments = new cbp_segment_decoder_c(trace_file_name, *index, skip_insts, decode_threads);
+        }
+        else if(index && index->find_segment(skip_insts) != 0){
+            // start decoding at the restart point before the first instruction wanted
+            size_t seg = std::min(index->find_segment(skip_insts), index->segments.size() - 1);
+            skip_insts -= index->segment_start(seg);
+            from_cbp_trace_input = bz2_input_open_at(trace_file_name.c_str(), index->segments[seg].offset);
+        }
+        else{
+            from_cbp_trace_input = bz2_input_open(trace_file_name.c_str(), config.decode_threads);
+        }
+        if(from_cbp_trace_input){
+            from_cbp_inst_stream = cbp_inst_open(from_cbp_trace_input);
+            if(index){
+                cbp_inst_set_restart_interval(from_cbp_inst_stream, index->restart_interval);
+            }
+            for(uint64_t i = 0; i < skip_insts && cbp_inst_read(from_cbp_inst_stream, &cbp_inst); i++){
+            }
+        }
+    }
     // initialize op_state
     osptr = new op_state_c();
     osptr->init(osptr);
@@ -47,6 +314,8 @@ cbp_trace_reader_c::cbp_trace_reader_c(char *trace_name){
     is_branch_tkn             = false;
     predict_branch_tkn_copy   = false;
     predict_valid             = false;
+    have_branch               = false;
+    branch_scored             = false;
     stat_num_branches         = 0;
     stat_num_cc_branches      = 0;
     stat_num_predicts         = 0;
@@ -61,20 +330,110 @@ cbp_trace_reader_c::cbp_trace_reader_c(char *trace_name){
     cbp_inst.is_return = false;
     cbp_inst.branch_target = 0;
     cbp_inst.taken = false;
+
+    if(config.pipelined && !segments){
+        pipe = new cbp_branch_pipe_c();
+        pipe->decoder = std::thread(&cbp_trace_reader_c::decode_thread, this);
+    }
 }
 
 cbp_trace_reader_c::~cbp_trace_reader_c(){
+    // the decode thread owns the decode statistics until it's done
+    if(pipe){
+        pipe->stopping = true;
+        pipe->decoder.join();
+        delete pipe;
+    }
+    delete segments;
+    if(print_statistics && sample_period){
+        print_sample_statistics();
+    }
+    else if(print_statistics){
+        printf("*********************************************************\n");
+        int   mis_preds     = (stat_num_cc_branches - stat_num_correct_predicts);
+        float mis_pred_rate = float(mis_preds)/(float(stat_num_insts) / 1000);
+        printf("1000*wrong_cc_predicts/total insts: 1000 * %8d / %8d = %7.3f\n", mis_preds, stat_num_insts, mis_pred_rate);
+        printf("total branches:                  %8d\n", stat_num_branches);
+        printf("total cc branches:               %8d\n", stat_num_cc_branches);
+        printf("total predicts:                  %8d\n", stat_num_predicts);
+        printf("*********************************************************\n");
+    }
+    if(print_statistics && profile){
+        profile->print(stdout, stat_num_insts);
+    }
+    delete profile;
+    if(from_cbp_inst_stream){
+        cbp_inst_close(from_cbp_inst_stream);
+    }
+    delete from_cbp_trace_input;
+    delete from_br_trace;
+    delete index;
+    delete osptr;
+}
+
+// prints the statistics of the measured intervals in the same form as a full run, followed by a
+// 95% confidence interval for the mispredict rate.  Each interval's mispredict rate is weighted
+// by its number of instructions, which only differs for an interval cut short by the end of the trace.
+uint64_t cbp_trace_reader_c::num_sample_intervals() const{
+    if(stat_num_insts <= sample_warmup){
+        return 0;
+    }
+    return (stat_num_insts - sample_warmup + sample_period - 1) / sample_period;
+}
+uint cbp_trace_reader_c::sample_interval_insts(uint64_t interval) const{
+    uint64_t start = interval * sample_period + sample_warmup;
+    uint64_t end   = min(start + sample_length, uint64_t(stat_num_insts));
+    return uint(end - start);
+}
+uint cbp_trace_reader_c::num_scored_insts() const{
+    if(!sample_period){
+        return stat_num_insts;
+    }
+    uint insts = 0;
+    for(uint64_t k = 0; k < num_sample_intervals(); k++){
+        insts += sample_interval_insts(k);
+    }
+    return insts;
+}
+void cbp_trace_reader_c::print_sample_statistics(){
+    uint64_t num_intervals = num_sample_intervals();
+    sample_intervals.resize(num_intervals);
+    uint   branches    = 0;
+    uint   cc_branches = 0;
+    uint   mis_preds   = 0;
+    uint   insts       = 0;
+    vector<double> interval_insts(num_intervals);
+    vector<double> interval_rates(num_intervals);
+    for(uint64_t k = 0; k < num_intervals; k++){
+        const cbp_sample_interval_c &interval = sample_intervals[k];
+        interval_insts[k] = sample_interval_insts(k);
+        interval_rates[k] = 1000 * double(interval.cc_branches - interval.correct_predicts) / interval_insts[k];
+        branches    += interval.branches;
+        cc_branches += interval.cc_branches;
+        mis_preds   += interval.cc_branches - interval.correct_predicts;
+        insts       += sample_interval_insts(k);
+    }
+    double mis_pred_rate = insts ? 1000 * double(mis_preds) / insts : 0;
+    double variance      = 0;
+    for(uint64_t k = 0; k < num_intervals; k++){
+        double d  = interval_rates[k] - mis_pred_rate;
+        variance += interval_insts[k] * d * d;
+    }
+    double confidence = 0;
+    if(num_intervals > 1){
+        variance  *= double(num_intervals) / (double(num_intervals - 1) * insts);
+        confidence = 1.96 * sqrt(variance / num_intervals);
+    }
     printf("*********************************************************\n");
-    int   mis_preds     = (stat_num_cc_branches - stat_num_correct_predicts);
-    float mis_pred_rate = float(mis_preds)/(float(stat_num_insts) / 1000);
-    printf("1000*wrong_cc_predicts/total insts: 1000 * %8d / %8d = %7.3f\n", mis_preds, stat_num_insts, mis_pred_rate);
-    printf("total branches:                  %8d\n", stat_num_branches);
-    printf("total cc branches:               %8d\n", stat_num_cc_branches);
+    printf("1000*wrong_cc_predicts/total insts: 1000 * %8d / %8d = %7.3f\n", mis_preds, insts, mis_pred_rate);
+    printf("total branches:                  %8d\n", branches);
+    printf("total cc branches:               %8d\n", cc_branches);
     printf("total predicts:                  %8d\n", stat_num_predicts);
+    printf("sampled intervals:               %8d of %llu insts, %llu warmup, every %llu\n", uint(num_intervals),
+           (unsigned long long)sample_length, (unsigned long long)sample_warmup, (unsigned long long)sample_period);
+    printf("trace insts:                     %8d\n", stat_num_insts);
+    printf("95%% confidence interval:         %7.3f +/- %.3f\n", mis_pred_rate, confidence);
     printf("*********************************************************\n");
-    cbp_inst_close(from_cbp_inst_stream);
-    pclose(from_cbp_trace_file);
-    delete osptr;
 }
 
 bool cbp_trace_reader_c::predict_branch(bool predict_branch_tkn){
@@ -90,7 +449,18 @@ bool cbp_trace_reader_c::predict_branch(bool predict_branch_tkn){
 
 
 bool cbp_trace_reader_c::get_branch_record(branch_record_c *branch_record){
-    if(stat_num_branches != 0){
+    if(have_branch && branch_scored){
+        if(sample_period){
+            cbp_sample_interval_c &interval = sample_intervals[branch_interval];
+            if(branch_record->is_conditional){
+                interval.cc_branches++;
+                interval.correct_predicts += (predict_valid && predict_branch_tkn_copy == is_branch_tkn);
+            }
+        }
+        if(profile && branch_record->is_conditional){
+            profile->record(branch_record->instruction_addr, branch_insts,
+                            !(predict_valid && predict_branch_tkn_copy == is_branch_tkn));
+        }
         if(!predict_valid){
             if(branch_record->is_conditional){
                 printf("*******No prediction made, you should at least try!*******\n");
@@ -106,6 +476,96 @@ bool cbp_trace_reader_c::get_branch_record(branch_record_c *branch_record){
             }
         }
     }
+    bool taken;
+    uint num_insts;
+    if(!next_branch_record(branch_record, &taken, &num_insts)){
+        return false;
+    }
+    branch_scored = true;
+    // in sampling mode, only the branches of the warmup and measured parts of each sample
+    // period are handed out, and only the measured ones are scored
+    while(sample_period){
+        uint64_t offset = (num_insts - 1) % sample_period;
+        if(offset < sample_warmup + sample_length){
+            branch_scored   = (offset >= sample_warmup);
+            branch_interval = (num_insts - 1) / sample_period;
+            if(branch_scored){
+                if(sample_intervals.size() <= branch_interval){
+                    sample_intervals.resize(branch_interval + 1);
+                }
+                sample_intervals[branch_interval].branches++;
+            }
+            break;
+        }
+        if(!next_branch_record(branch_record, &taken, &num_insts)){
+            return false;
+        }
+    }
+    is_branch_tkn = taken;
+    predict_valid = false;
+    have_branch   = true;
+    branch_insts  = num_insts;
+    return true;
+}
+
+// gets the next branch from wherever the trace is coming from; num_insts is set to the number
+// of instructions up to and including the branch
+bool cbp_trace_reader_c::next_branch_record(branch_record_c *branch_record, bool *taken, uint *num_insts){
+    if(pipe){
+        cbp_pipe_entry_c entry;
+        if(pipe->done){
+            return false;
+        }
+        pipe->ring.pop(&entry);
+        if(!entry.valid){
+            pipe->done = true;
+            return false;
+        }
+        *branch_record = entry.br;
+        *taken         = entry.taken;
+        *num_insts     = entry.num_insts;
+        return true;
+    }
+    if(segments){
+        cbp_segment_branch_c entry;
+        bool more = segments->next(&entry, &stat_num_insts);
+        if(stat_num_insts > max_insts){
+            stat_num_insts = uint(max_insts);
+            return false;
+        }
+        if(!more){
+            return false;
+        }
+        *branch_record = entry.br;
+        *taken         = entry.taken;
+        stat_num_branches++;
+        if(branch_record->is_conditional){
+            stat_num_cc_branches++;
+        }
+    }
+    else if(!decode_branch_record(branch_record, taken)){
+        return false;
+    }
+    *num_insts = stat_num_insts;
+    return true;
+}
+
+// the decode thread keeps the ring full until the trace ends or the reader is destroyed
+void cbp_trace_reader_c::decode_thread(){
+    cbp_pipe_entry_c entry;
+    do{
+        entry.valid     = decode_branch_record(&entry.br, &entry.taken);
+        entry.num_insts = stat_num_insts;
+        if(!pipe->ring.push(entry, pipe->stopping)){
+            return;
+        }
+    } while(entry.valid);
+}
+
+bool cbp_trace_reader_c::decode_branch_record(branch_record_c *branch_record, bool *taken){
+    if(from_br_trace){
+        return get_br_trace_record(branch_record, taken);
+    }
     // init cbp_inst
     memset(&cbp_inst, 0, sizeof(cbp_inst));
     cbp_inst.instruction_next_addr = 0;
@@ -116,67 +576,21 @@ bool cbp_trace_reader_c::get_branch_record(branch_record_c *branch_record){
     cbp_inst.branch_target = 0;
     cbp_inst.taken = false;
     // populate the cbp_inst record
-    op_record_c *op = 0;
     while(!cbp_inst.is_branch){
-        if(feof(from_cbp_trace_file)){
-            return false;
-        }
-        if(!cbp_inst_read(from_cbp_inst_stream, &cbp_inst)){
+        if(stat_num_insts >= max_insts || !cbp_inst_read(from_cbp_inst_stream, &cbp_inst)){
             return false;
         }
-        osptr->inc_clock();
-        uint opl_ptr = osptr->op_list_ptr;
-        op = osptr->op_list + opl_ptr;
-        if(op->is_valid){
-            //commit op
-            if(op->dst != REG_NUL){
-                assert(op->dst < osptr->num_regs);
-                osptr->regs[op->dst]       = op->get_dst_val();
-                osptr->regs_valid[op->dst] = true;
-            }
-        }
-        op->init();
-        op->is_valid         = true;
-        op->op_class         = cbp_inst.op_class;
-        op->instruction_addr = cbp_inst.instruction_addr;
-        op->is_load          = cbp_inst.is_load;
-        op->is_store         = cbp_inst.is_store;
-        op->is_branch        = cbp_inst.is_branch;
-        op->is_op            = cbp_inst.is_op;
-        op->is_fp            = cbp_inst.is_fp;
-        op->read_flg         = cbp_inst.read_flg;
-        op->writ_flg         = cbp_inst.writ_flg;
-        op->src1             = cbp_inst.src1;
-        op->src2             = cbp_inst.src2;
-        op->dst              = cbp_inst.dst;
-        op->has_mem_src      = cbp_inst.has_mem_src;
-        op->has_mem_dst      = cbp_inst.has_mem_dst;
-        op->mem_src1         = cbp_inst.mem_src1;
-        op->mem_src2         = cbp_inst.mem_src2;
-        op->mem_src3         = cbp_inst.mem_src3;
-        op->set_src1_val(cbp_inst.src1_val);
-        op->set_src2_val(cbp_inst.src2_val);
-        op->set_dst_val(cbp_inst.dst_val);
-        op->set_src_vaddr(cbp_inst.src_vaddr);
-        op->set_dst_vaddr(cbp_inst.src_vaddr);
         stat_num_insts++;
-        //op->debug_print();
+        // predictors that don't use op_state only need the instructions counted
+        if(maintain_op_state){
+            osptr->insert_op(cbp_inst);
+        }
     }
     assert(cbp_inst.is_branch);
     // cbp_inst has been populated 
     // set branch record
-    branch_record->init();
-    assert(op);
-    assert(op->instruction_addr == cbp_inst.instruction_addr);
-    branch_record->instruction_addr      = cbp_inst.instruction_addr;
-    branch_record->branch_target         = cbp_inst.branch_target;
-    branch_record->instruction_next_addr = cbp_inst.instruction_next_addr;
-    branch_record->is_indirect           = cbp_inst.is_indirect;
-    branch_record->is_conditional        = cbp_inst.is_conditional;
-    branch_record->is_call               = cbp_inst.is_call;
-    branch_record->is_return             = cbp_inst.is_return;
-    is_branch_tkn                        = cbp_inst.taken;
-    predict_valid                        = false;
+    set_branch_record(branch_record, cbp_inst);
+    *taken                               = cbp_inst.taken;
     stat_num_branches++;
     if(branch_record->is_conditional){
         stat_num_cc_branches++;
@@ -185,11 +599,41 @@ bool cbp_trace_reader_c::get_branch_record(branch_record_c *branch_record){
     return true;
 }
 
-
-
-
-
-
-
-
-
+// replays the next branch of a .brt branch trace; the statistics come out the same as decoding
+// the original trace, but op_state is left untouched
+bool cbp_trace_reader_c::get_br_trace_record(branch_record_c *branch_record, bool *taken){
+    if(br_trace_done){
+        return false;
+    }
+    const br_trace_record_c *rec = from_br_trace->next();
+    // skipped instructions come off the front of each record's instruction count
+    while(rec && br_trace_skip >= rec->num_insts()){
+        br_trace_skip -= rec->num_insts();
+        rec = from_br_trace->next();
+    }
+    if(!rec || stat_num_insts + rec->num_insts() - br_trace_skip > max_insts){
+        // the instructions after the last branch, up to the end of the trace or to max_insts
+        uint64_t tail = rec ? rec->num_insts() : from_br_trace->tail_insts();
+        if(br_trace_skip < tail){
+            stat_num_insts = uint(min(stat_num_insts + tail - br_trace_skip, max_insts));
+        }
+        br_trace_done = true;
+        return false;
+    }
+    stat_num_insts += rec->num_insts() - br_trace_skip;
+    br_trace_skip = 0;
+    branch_record->init();
+    branch_record->instruction_addr      = rec->instruction_addr;
+    branch_record->branch_target         = rec->branch_target;
+    branch_record->instruction_next_addr = rec->instruction_next_addr;
+    branch_record->is_indirect           = (rec->info & br_trace_record_c::BR_TRACE_IS_INDIRECT) != 0;
+    branch_record->is_conditional        = (rec->info & br_trace_record_c::BR_TRACE_IS_CONDITIONAL) != 0;
+    branch_record->is_call               = (rec->info & br_trace_record_c::BR_TRACE_IS_CALL) != 0;
+    branch_record->is_return             = (rec->info & br_trace_record_c::BR_TRACE_IS_RETURN) != 0;
+    *taken                               = (rec->info & br_trace_record_c::BR_TRACE_TAKEN) != 0;
+    stat_num_branches++;
+    if(branch_record->is_conditional){
+        stat_num_cc_branches++;
+    }
+    return true;
+}
@@ -7,12 +7,18 @@
 #define TREAD_H_SEEN
 
 #include <cstdio>
+#include <vector>
 #include "cbp_inst.h"
 
 typedef unsigned int uint;
 
 class op_record_c;
 class op_state_c;
+class br_trace_file_c;
+class branch_profile_c;
+class cbp_branch_pipe_c;
+class cbp_segment_decoder_c;
+class trace_index_c;
 
 class branch_record_c
 {
@@ -30,12 +36,65 @@ public:
     bool   is_return;              // true if the branch is a return; false otherwise        
 };
 
+// settings for how the trace reader gets at a trace.  The defaults give the
+// statistics of the original framework, but decompress the trace on one thread
+// per core (decode_threads); set decode_threads to 1 to decode on the
+// caller's thread, as the original framework did.
+class cbp_reader_config_c
+{
+public:
+    cbp_reader_config_c();
+    uint decode_threads;           // threads decompressing (or decoding) the trace; 0 uses one per core, 1 decodes inline
+    // decode branches on a separate thread that runs ahead of the predictor; the statistics
+    // are identical, but op_state runs ahead of the branch being predicted, so this is only
+    // for predictors that don't use op_state
+    bool pipelined;
+    // keep op_state up to date; a predictor that never looks at op_state can turn this off,
+    // and the reader then only counts the instructions between branches
+    bool maintain_op_state;
+    // start the trace at this instruction (the first is 0); the instructions before it are
+    // neither counted nor put in op_state.  A segmented trace (see cbpsegment) jumps straight
+    // to the segment holding it, and other traces decode their way there.
+    uint64_t skip_insts;
+    // end the trace after this instruction (counting from the start of the trace, not from
+    // skip_insts); 0 reads to the end.  A run with stop_insts N and one with skip_insts N split
+    // the trace between them.
+    uint64_t stop_insts;
+    // sampling mode: if sample_period isn't 0, the trace is split into periods of sample_period
+    // instructions, and only the first sample_warmup + sample_length instructions of each period
+    // reach the predictor.  The predictor is trained but not scored on the first sample_warmup,
+    // and the statistics are estimated from the sample_length instructions after them.
+    uint64_t sample_period;
+    uint64_t sample_length;
+    uint64_t sample_warmup;
+    // print the statistics when the reader is destroyed; a runner that reports the results
+    // itself turns this off
+    bool print_statistics;
+    // profiling (see branch_profile.h), printed after the statistics: if profile_interval isn't
+    // 0, the mispredicts in each interval of that many instructions, and if profile_top isn't 0,
+    // that many of the static branches with the most mispredicts
+    uint64_t profile_interval;
+    uint profile_top;
+};
+
+// the scored branches of one measured interval in sampling mode
+class cbp_sample_interval_c
+{
+public:
+    cbp_sample_interval_c() : branches(0), cc_branches(0), correct_predicts(0) {}
+    uint branches;
+    uint cc_branches;
+    uint correct_predicts;
+};
+
 class cbp_trace_reader_c
 {
 private:
     bool is_branch_tkn;                             // the holy grail, this should never be used in a predictor algorithm 
     bool predict_branch_tkn_copy;                   // the treader tucks away the prediction made by predictor    
     bool predict_valid;                             // is the current prediction in predict_branch_tkn_copy valid
+    bool have_branch;                               // a branch record has been handed out
+    bool branch_scored;                             // the branch handed out counts toward the statistics
 
     // stats 
     uint stat_num_branches;                         // stat that tracks the number of branches observed during trace processing           
@@ -45,14 +104,45 @@ private:
     uint stat_num_correct_predicts;                 // stat that tracks the number of branches correctly predicted during trace processing
 
     cbp::CBP_INST cbp_inst;
-    std::FILE* from_cbp_trace_file; 
+    cbp::CBP_INPUT *from_cbp_trace_input;           // decompresses <trace>.bz2 in-process
     cbp::CBP_INST_STREAM *from_cbp_inst_stream;
+    br_trace_file_c *from_br_trace;                 // set instead when replaying a .brt branch trace
+    bool br_trace_done;                             // the instructions after the last branch have been counted
+    uint64_t br_trace_skip;                         // instructions still to skip in a .brt branch trace
+    uint64_t max_insts;                             // stat_num_insts at which the trace ends (see stop_insts)
+
+    cbp_branch_pipe_c *pipe;                        // set in pipelined mode
+    trace_index_c *index;                           // the restart index of a segmented trace
+    cbp_segment_decoder_c *segments;                // set when decoding the segments of a segmented trace in parallel
+
+    // sampling mode (see cbp_reader_config_c)
+    uint64_t sample_period;
+    uint64_t sample_length;
+    uint64_t sample_warmup;
+    uint64_t branch_interval;                       // the sample period of the branch handed out
+    std::vector<cbp_sample_interval_c> sample_intervals;
+    uint64_t num_sample_intervals() const;
+    uint sample_interval_insts(uint64_t interval) const;
+    void print_sample_statistics();
+    bool maintain_op_state;                         // false in branch-only mode
+    bool print_statistics;
+    branch_profile_c *profile;                      // set when profiling
+    uint branch_insts;                              // the instructions up to and including the branch handed out
+
+    // decode the next branch of the trace into branch_record and taken; returns false at the end
+    // of the trace.  In pipelined mode these run on the decode thread.
+    bool decode_branch_record(branch_record_c *branch_record, bool *taken);
+    bool get_br_trace_record(branch_record_c *branch_record, bool *taken);
+    bool next_branch_record(branch_record_c *branch_record, bool *taken, uint *num_insts);
+    void decode_thread();
 
 public:
     // op_state
     op_state_c *osptr;
-    // cbp_trace_reader_c is passed a string specifying the name of the trace file
-    cbp_trace_reader_c(char *trace_name);
+    // cbp_trace_reader_c is passed a string specifying the name of the trace file; a name ending
+    // in ".brt" is replayed from a branch trace written by brconvert, in which case op_state is
+    // never updated.  If <trace>.idx exists, <trace>.bz2 is a segmented trace written by cbpsegment.
+    cbp_trace_reader_c(char *trace_name, const cbp_reader_config_c &config = cbp_reader_config_c());
     ~cbp_trace_reader_c();
     // call this to let the trace reader know what your prediction is; after it's called the prediction 
     // will get tucked away internally in predict_branch_tkn_copy and predict_valid is set; 
@@ -63,6 +153,12 @@ public:
     // returns true if there is still another branch record in the trace.  false if the end of the branch trace 
     // has been reached.
     bool get_branch_record(branch_record_c *branch_record); 
+    // true if the branch handed out by get_branch_record counts toward the statistics; only
+    // warmup branches in sampling mode don't
+    bool is_branch_scored() const { return branch_scored; }
+    // the number of instructions the statistics are taken over: all of them, or in sampling
+    // mode the measured ones.  Only valid once get_branch_record has returned false.
+    uint num_scored_insts() const;
 };
 
 #endif // TREAD_H_SEEN
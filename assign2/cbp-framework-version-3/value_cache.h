@@ -28,9 +28,12 @@ namespace cbp
         static std::size_t get_index(uint64_t val);
 
       public:
-        VALUE_CACHE(void) { std::fill_n(cache, NUM_SETS, 0); }
+        VALUE_CACHE(void) { reset(); }
         // uses compiler generated destructor
 
+        // returns the cache to its initial state
+        void reset(void) { std::fill_n(cache, NUM_SETS, 0); }
+
         typedef int id_type;   // value identifier
         static const id_type NOT_FOUND = id_type(-1);
 